@@ -0,0 +1,63 @@
+# bench_startup.py
+# Time-to-first-step of the simulator at increasing world counts, with the
+# per-world constructor path and with lazy_init's bulk fill. Each
+# configuration runs in a fresh process so allocator and page cache state
+# from a previous run don't skew the next one.
+#
+#   python bench_startup.py --num_worlds 1024 65536 524288 --num_threads 0
+import argparse
+import json
+import subprocess
+import sys
+import time
+
+NUM_PLAYERS = 4
+
+def load_initial_positions(path):
+    with open(path, 'r') as file:
+        players = json.load(file)["players"][:NUM_PLAYERS]
+    return [[p["x"], p["y"], p["theta"], p["velocity"], p["angular v"], p["facing angle"]] for p in players]
+
+def measure(num_worlds, lazy_init, num_threads, gpu, load_state):
+    import torch
+    from madrona_simple_example import GridWorld
+
+    start = time.perf_counter()
+    grid_world = GridWorld(load_initial_positions(load_state), num_worlds, gpu, 0,
+                           num_threads=num_threads, lazy_init=lazy_init)
+    constructed = time.perf_counter()
+    grid_world.step()
+    if gpu:
+        torch.cuda.synchronize()
+    stepped = time.perf_counter()
+    return {"construct_s": constructed - start, "first_step_s": stepped - constructed,
+            "total_s": stepped - start}
+
+def main():
+    arg_parser = argparse.ArgumentParser()
+    arg_parser.add_argument('--num_worlds', type=int, nargs='+', default=[1024, 65536, 524288])
+    arg_parser.add_argument('--num_threads', type=int, default=0)
+    arg_parser.add_argument('--gpu', action='store_true')
+    arg_parser.add_argument('--load_state', type=str, default="gamestates/2v2init.json")
+    arg_parser.add_argument('--child', type=str, default=None, help=argparse.SUPPRESS)
+    args = arg_parser.parse_args()
+
+    if args.child is not None:
+        num_worlds, lazy_init = json.loads(args.child)
+        print(json.dumps(measure(num_worlds, lazy_init, args.num_threads, args.gpu, args.load_state)))
+        return
+
+    print(f"{'worlds':>8} {'mode':>6} {'construct':>10} {'first step':>11} {'total':>8}")
+    for num_worlds in args.num_worlds:
+        for lazy_init in (False, True):
+            cmd = [sys.executable, __file__, '--child', json.dumps([num_worlds, lazy_init]),
+                   '--num_threads', str(args.num_threads), '--load_state', args.load_state]
+            if args.gpu:
+                cmd.append('--gpu')
+            out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+            result = json.loads(out.strip().splitlines()[-1])
+            print(f"{num_worlds:>8} {'lazy' if lazy_init else 'eager':>6} {result['construct_s']:>9.2f}s "
+                  f"{result['first_step_s']:>10.3f}s {result['total_s']:>7.2f}s")
+
+if __name__ == "__main__":
+    main()
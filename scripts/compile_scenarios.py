@@ -0,0 +1,100 @@
+# compile_scenarios.py
+# Packs gamestate JSON files into one binary scenario bank that the simulator
+# memory maps at startup (see src/scenario_bank.hpp for the layout), so resets
+# never touch the filesystem or a JSON parser.
+#
+#   python compile_scenarios.py -o scenarios.bin gamestates/2v2init.json gamestates/passing_testing.json:3
+#
+# An optional ":weight" suffix sets the weight used by weighted sampling. For
+# curriculum sampling, list the scenarios from easiest to hardest.
+import argparse
+import glob
+import json
+import os
+import struct
+import sys
+
+import numpy as np
+
+SCENARIO_BANK_MAGIC = 0x4e435342  # "BSCN"
+SCENARIO_BANK_VERSION = 1
+ACTIVE_PLAYERS = 4
+
+PLAYER_DTYPE = np.dtype([
+    ("id", np.int32), ("x", np.float32), ("y", np.float32), ("th", np.float32),
+    ("v", np.float32), ("om", np.float32), ("facing", np.float32),
+])
+
+SCENARIO_DTYPE = np.dtype([
+    ("players", PLAYER_DTYPE, (ACTIVE_PLAYERS,)),
+    ("ball_x", np.float32), ("ball_y", np.float32),
+    ("ball_th", np.float32), ("ball_v", np.float32),
+    ("who_holds", np.int32), ("who_shot", np.int32),
+])
+
+def parse_input(arg):
+    path, sep, weight = arg.rpartition(":")
+    if sep and os.path.exists(path):
+        return path, float(weight)
+    return arg, 1.0
+
+def load_scenario(path):
+    with open(path, 'r') as file:
+        game_state = json.load(file)
+
+    players = game_state["players"]
+    if len(players) < ACTIVE_PLAYERS:
+        raise ValueError(f"{path} has {len(players)} players, need {ACTIVE_PLAYERS}")
+    if len(players) > ACTIVE_PLAYERS:
+        print(f"warning: {path} has {len(players)} players, keeping the first {ACTIVE_PLAYERS}", file=sys.stderr)
+
+    scenario = np.zeros((), dtype=SCENARIO_DTYPE)
+    for i in range(ACTIVE_PLAYERS):
+        p = players[i]
+        scenario["players"][i] = (i, p["x"], p["y"], p["theta"], p["velocity"],
+                                  p["angular v"], p["facing angle"])
+
+    ball = game_state["ball"]
+    who_holds = int(ball["who holds"])
+    who_shot = int(ball["who shot"])
+    if who_holds >= ACTIVE_PLAYERS:
+        print(f"warning: {path} ball holder {who_holds} was dropped, ball starts loose", file=sys.stderr)
+        who_holds = -1
+    if who_shot >= ACTIVE_PLAYERS:
+        who_shot = -1
+
+    scenario["ball_x"] = ball["x"]
+    scenario["ball_y"] = ball["y"]
+    scenario["ball_th"] = ball["theta"]
+    scenario["ball_v"] = ball["velocity"]
+    scenario["who_holds"] = who_holds
+    scenario["who_shot"] = who_shot
+    return scenario
+
+def main():
+    arg_parser = argparse.ArgumentParser()
+    arg_parser.add_argument('inputs', nargs='*', help="gamestate JSON files, optionally path:weight")
+    arg_parser.add_argument('-o', '--output', type=str, default="scenarios.bin")
+    args = arg_parser.parse_args()
+
+    inputs = args.inputs or sorted(glob.glob("gamestates/*.json"))
+    if not inputs:
+        arg_parser.error("no gamestate files given")
+
+    scenarios = np.zeros(len(inputs), dtype=SCENARIO_DTYPE)
+    weights = np.zeros(len(inputs), dtype=np.float32)
+    for i, arg in enumerate(inputs):
+        path, weight = parse_input(arg)
+        scenarios[i] = load_scenario(path)
+        weights[i] = weight
+
+    with open(args.output, 'wb') as file:
+        file.write(struct.pack("<4I", SCENARIO_BANK_MAGIC, SCENARIO_BANK_VERSION,
+                               len(inputs), ACTIVE_PLAYERS))
+        file.write(scenarios.tobytes())
+        file.write(weights.tobytes())
+
+    print(f"Compiled {len(inputs)} scenarios into {args.output}")
+
+if __name__ == "__main__":
+    main()
@@ -5,30 +5,7 @@ import torch.optim as optim
 import numpy as np
 from torch.distributions import Normal, Categorical
 import gym
-from collections import deque
-import random
-
-class ReplayBuffer:
-    def __init__(self, capacity):
-        self.buffer = deque(maxlen=capacity)
-    
-    def push(self, state, cont_action, disc_action, reward, next_state, done):
-        self.buffer.append((state, cont_action, disc_action, reward, next_state, done))
-    
-    def sample(self, batch_size):
-        batch = random.sample(self.buffer, batch_size)
-        state, cont_action, disc_action, reward, next_state, done = zip(*batch)
-        return (
-            torch.stack(state, dim=0).to(dtype=torch.float32),
-            torch.stack(cont_action, dim=0).to(dtype=torch.float32),
-            torch.tensor(list(disc_action), dtype=torch.int64),
-            torch.tensor(list(reward), dtype=torch.float32),
-            torch.stack(next_state, dim=0).to(dtype=torch.float32),
-            torch.tensor(list(done), dtype=torch.float32)
-        )
-    
-    def __len__(self):
-        return len(self.buffer)
+from madrona_simple_example.replay import ReplayBuffer
 
 class HybridSACPolicy(nn.Module):
     def __init__(self, state_dim, continuous_dim, discrete_dim):
@@ -213,7 +190,7 @@ class HybridSAC:
         self.policy_optimizer = optim.Adam(self.policy.parameters(), lr=self.lr)
         self.critic_optimizer = optim.Adam(self.critic.parameters(), lr=self.lr)
         
-        self.replay_buffer = ReplayBuffer(self.buffer_size)
+        self.replay_buffer = ReplayBuffer(self.buffer_size, state_dim, continuous_dim, 1, max_batch_size=self.batch_size)
         
         if self.auto_entropy_tuning:
             self.target_entropy_d = -1.0 * np.log(discrete_dim)
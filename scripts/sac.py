@@ -5,29 +5,7 @@ import torch.optim as optim
 import numpy as np
 from torch.distributions import Normal
 import gym
-from collections import deque
-import random
-
-class ReplayBuffer:
-    def __init__(self, capacity):
-        self.buffer = deque(maxlen=capacity)
-    
-    def push(self, state, action, reward, next_state, done):
-        self.buffer.append((state, action, reward, next_state, done))
-    
-    def sample(self, batch_size):
-        batch = random.sample(self.buffer, batch_size)
-        state, action, reward, next_state, done = zip(*batch)
-        return (
-            torch.stack(state, dim=0).to(dtype=torch.float32),
-            torch.stack(action, dim=0).to(dtype=torch.float32),
-            torch.tensor(list(reward), dtype=torch.float32),
-            torch.stack(next_state, dim=0).to(dtype=torch.float32),
-            torch.tensor(list(done), dtype=torch.float32)
-        )
-    
-    def __len__(self):
-        return len(self.buffer)
+from madrona_simple_example.replay import ReplayBuffer
 
 class ContinuousSACPolicy(nn.Module):
     def __init__(self, state_dim, action_dim, action_scale=1.0, hidden_dim=256):
@@ -145,7 +123,7 @@ class SAC:
         self.policy_optimizer = optim.Adam(self.policy.parameters(), lr=lr)
         self.critic_optimizer = optim.Adam(self.critic.parameters(), lr=lr)
         
-        self.replay_buffer = ReplayBuffer(buffer_size)
+        self.replay_buffer = ReplayBuffer(buffer_size, state_dim, action_dim, max_batch_size=batch_size)
         
         if auto_entropy_tuning:
             self.target_entropy = target_entropy_scale * action_dim
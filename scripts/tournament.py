@@ -0,0 +1,450 @@
+# tournament.py
+# Headless policy-vs-policy evaluation. Every (offense, defense) pairing of the
+# given policies is spread across the simulator's worlds and played for a fixed
+# number of possessions per seed, then points per possession and head to head
+# win rates are reported with 95% confidence intervals.
+#
+#   python tournament.py --policies idle drive shooter pass_first --num_worlds 4096 --possessions 2000
+#   python tournament.py --policies drive torchscript:league/v3.pt rllib:checkpoints/evenbettermodels/iter_950
+#
+# A possession starts from the initial state (or the scenario bank) with
+# whichever team holds the ball on offense, and ends on the first make, miss,
+# defensive catch or steal, or when the shot clock runs out with no shot in
+# the air. Worlds that finish a possession are reset and handed to the matchup
+# with the most possessions still outstanding, so no world idles until the
+# whole league is done.
+import argparse
+import csv
+import json
+import time
+
+import numpy as np
+import torch
+from madrona_simple_example import GridWorld
+from madrona_simple_example.gridworld import EVENT_LOG_CAPACITY, EVENT_TYPES
+
+PLAYERS_PER_TEAM = 2
+NUM_PLAYERS = PLAYERS_PER_TEAM * 2
+LEFT_HOOP_X = -41.75
+RIGHT_HOOP_X = 41.75
+PASSING_VELOCITY = 35.0
+MAX_SPEED = 20.0
+D_T = 0.05 # Must match D_T in consts.hpp
+
+# PlayerDecision in types.hpp
+MOVE, SHOOT, PASS = 0, 1, 2
+
+SHOT, MAKE, MISS, CATCH, STEAL = (EVENT_TYPES.index(name) for name in ("shot", "make", "miss", "catch", "steal"))
+
+def wrap_angle(angle):
+    return (angle + np.pi) % (2 * np.pi) - np.pi
+
+class TeamState:
+    """One team's view of a batch of worlds. Players are ordered own team first,
+    and hoop is the (x, y) of the hoop this team shoots at."""
+    def __init__(self, grid_world, worlds, team):
+        own = torch.stack([team * PLAYERS_PER_TEAM, team * PLAYERS_PER_TEAM + 1], dim=1)
+        order = torch.cat([own, (own + PLAYERS_PER_TEAM) % NUM_PLAYERS], dim=1)
+
+        players = grid_world.player_pos[worlds]
+        self.worlds = worlds
+        self.own_ids = own
+        self.players = players.gather(1, order[:, :, None].expand(-1, -1, players.shape[2]))
+        self.own = self.players[:, :PLAYERS_PER_TEAM]
+        self.opp = self.players[:, PLAYERS_PER_TEAM:]
+        self.ball = grid_world.ball_pos[worlds]
+        self.ball_state = grid_world.who_holds[worlds, 3]
+
+        # Team 1 (players 0, 1) shoots at the left hoop, see takePlayerAction
+        hoop_x = torch.where(team == 0, LEFT_HOOP_X, RIGHT_HOOP_X).to(self.ball.dtype)
+        self.hoop = torch.stack([hoop_x, torch.zeros_like(hoop_x)], dim=1)
+        self.defended_hoop = torch.stack([-hoop_x, torch.zeros_like(hoop_x)], dim=1)
+
+        # Slot of the holder in players, -1 when nobody holds the ball
+        holder = grid_world.who_holds[worlds, 0].long()
+        slot = torch.full_like(holder, -1)
+        for i in range(NUM_PLAYERS):
+            slot = torch.where(holder == order[:, i], i, slot)
+        self.holder_slot = slot
+
+    def actions(self):
+        n = self.own.shape[0]
+        return (torch.zeros((n, PLAYERS_PER_TEAM, 5), dtype=self.own.dtype, device=self.own.device),
+                torch.full((n, PLAYERS_PER_TEAM), MOVE, dtype=torch.int32, device=self.own.device))
+
+def move_toward(actions, state, slot, target, speed, look_at = None):
+    # Runs player slot of every world at target, slowing down on arrival, and
+    # turns them to face look_at (default: where they are going)
+    pos = state.own[:, slot, :2]
+    delta = target - pos
+    dist = delta.norm(dim=1)
+    actions[:, slot, 0] = torch.clamp(dist / D_T, max=speed)
+    actions[:, slot, 1] = torch.atan2(delta[:, 1], delta[:, 0])
+    look = (look_at if look_at is not None else target) - pos
+    facing = torch.atan2(look[:, 1], look[:, 0])
+    actions[:, slot, 2] = wrap_angle(facing - state.own[:, slot, 5]) / (4 * D_T)
+
+def chase_loose_ball(actions, state):
+    loose = state.holder_slot < 0
+    for slot in range(PLAYERS_PER_TEAM):
+        chase = actions.clone()
+        move_toward(chase, state, slot, state.ball[:, :2], MAX_SPEED)
+        actions[loose, slot] = chase[loose, slot]
+
+def wing_spot(state, slot):
+    # Spot the off-ball offensive player spaces to, opposite the handler
+    side = torch.where(state.own[:, 1 - slot, 1] > 0, -1.0, 1.0)
+    x = state.hoop[:, 0] - torch.sign(state.hoop[:, 0]) * 18.0
+    return torch.stack([x, side * 15.0], dim=1)
+
+def nearest_defender_dist(state, slot):
+    return (state.opp[:, :, :2] - state.own[:, slot, None, :2]).norm(dim=2).min(dim=1).values
+
+def attack(state, shot_range, pass_pressure = None):
+    actions, decisions = state.actions()
+    for slot in range(PLAYERS_PER_TEAM):
+        handler = state.holder_slot == slot
+        spacing = actions.clone()
+        move_toward(spacing, state, slot, wing_spot(state, slot), MAX_SPEED, look_at=state.hoop)
+        move_toward(actions, state, slot, state.hoop, MAX_SPEED, look_at=state.hoop)
+        actions[~handler, slot] = spacing[~handler, slot]
+
+        in_range = (state.own[:, slot, :2] - state.hoop).norm(dim=1) < shot_range
+        decisions[handler & in_range, slot] = SHOOT
+
+        if pass_pressure is not None:
+            mate = 1 - slot
+            pressured = nearest_defender_dist(state, slot) < pass_pressure
+            mate_open = nearest_defender_dist(state, mate) >= pass_pressure
+            passing = handler & ~in_range & pressured & mate_open
+            to_mate = state.own[:, mate, :2] - state.own[:, slot, :2]
+            actions[passing, slot, 3] = torch.atan2(to_mate[passing, 1], to_mate[passing, 0])
+            actions[passing, slot, 4] = PASSING_VELOCITY
+            decisions[passing, slot] = PASS
+    chase_loose_ball(actions, state)
+    return actions, decisions
+
+def man_defense(state):
+    # Same spot as SimulationPolicies.defend_player, between the man and the hoop
+    actions, decisions = state.actions()
+    for slot in range(PLAYERS_PER_TEAM):
+        man = state.opp[:, slot, :2]
+        spot = man * 0.75 + state.defended_hoop * 0.25
+        spot = spot * 0.95 + state.ball[:, :2] * 0.05
+        move_toward(actions, state, slot, spot, MAX_SPEED, look_at=man)
+    chase_loose_ball(actions, state)
+    return actions, decisions
+
+def zone_defense(state):
+    # Both defenders sag on the line from the hoop to the ball
+    actions, decisions = state.actions()
+    to_ball = state.ball[:, :2] - state.defended_hoop
+    direction = to_ball / to_ball.norm(dim=1, keepdim=True).clamp(min=1e-3)
+    for slot, depth in enumerate((6.0, 14.0)):
+        move_toward(actions, state, slot, state.defended_hoop + direction * depth, MAX_SPEED,
+                    look_at=state.ball[:, :2])
+    chase_loose_ball(actions, state)
+    return actions, decisions
+
+def press_defense(state):
+    # Closest defender jumps the handler, the other one takes the open man
+    actions, decisions = man_defense(state)
+    handler = state.holder_slot.clamp(min=PLAYERS_PER_TEAM) - PLAYERS_PER_TEAM
+    handler_pos = state.opp[torch.arange(state.opp.shape[0], device=handler.device), handler, :2]
+    dists = (state.own[:, :, :2] - handler_pos[:, None]).norm(dim=2)
+    presser = dists.argmin(dim=1)
+    for slot in range(PLAYERS_PER_TEAM):
+        pressing = actions.clone()
+        move_toward(pressing, state, slot, handler_pos, MAX_SPEED, look_at=handler_pos)
+        rows = (presser == slot) & (state.holder_slot >= PLAYERS_PER_TEAM)
+        actions[rows, slot] = pressing[rows, slot]
+    return actions, decisions
+
+def stand(state):
+    return state.actions()
+
+class ScriptedPolicy:
+    def __init__(self, offense, defense):
+        self.offense = offense
+        self.defense = defense
+
+    def act(self, state, on_offense):
+        return self.offense(state) if on_offense else self.defense(state)
+
+SCRIPTED_POLICIES = {
+    "idle": ScriptedPolicy(stand, stand),
+    "drive": ScriptedPolicy(lambda s: attack(s, shot_range=10.0), man_defense),
+    "shooter": ScriptedPolicy(lambda s: attack(s, shot_range=26.0), zone_defense),
+    "pass_first": ScriptedPolicy(lambda s: attack(s, shot_range=12.0, pass_pressure=6.0), press_defense),
+}
+
+class TorchScriptPolicy:
+    """Exported policy taking [n, 41] team observations, see observation(), and
+    returning [n, 2, 6] per player (vdes, thdes, omdes, pass_th, pass_v, decision)."""
+    def __init__(self, path):
+        self.model = torch.jit.load(path)
+        self.model.eval()
+
+    @staticmethod
+    def observation(state, on_offense):
+        n = state.players.shape[0]
+        holder = torch.nn.functional.one_hot(torch.where(state.holder_slot < 0, NUM_PLAYERS, state.holder_slot), NUM_PLAYERS + 1)
+        ball_state = torch.nn.functional.one_hot(state.ball_state.long(), 6)
+        offense = torch.full((n, 1), float(on_offense), device=state.ball.device)
+        return torch.cat([state.players.reshape(n, -1), state.ball, holder.float(), ball_state.float(),
+                          offense, state.hoop[:, :1] / RIGHT_HOOP_X], dim=1)
+
+    def act(self, state, on_offense):
+        with torch.no_grad():
+            out = self.model(self.observation(state, on_offense).float())
+        return out[:, :, :5].to(state.ball.dtype), out[:, :, 5].round().to(torch.int32)
+
+class RLlibPolicy:
+    """Offense and defense policies of a multi_agent_train.py checkpoint, with the
+    observation and action scaling of SimulationPolicies.get_PPO_actions."""
+    def __init__(self, path):
+        from ray.rllib.policy.policy import Policy
+        self.offense = Policy.from_checkpoint(f"{path}/policies/offense")
+        self.defense = Policy.from_checkpoint(f"{path}/policies/defense")
+
+    def act(self, state, on_offense):
+        grid_world = self.grid_world
+        worlds = state.worlds
+        who_holds = grid_world.who_holds[worlds].long().cpu()
+        one_hot = lambda values, size: np.eye(size, dtype=np.float32)[values.numpy()]
+        # Sorted by key, like the single world version
+        obs = np.concatenate([
+            grid_world.ball_pos[worlds].cpu().numpy().astype(np.float32),
+            one_hot(who_holds[:, 3], 6),
+            grid_world.player_pos[worlds].cpu().numpy().astype(np.float32).reshape(len(worlds), -1),
+            grid_world.scoreboard[worlds].cpu().numpy().astype(np.float32),
+            one_hot(who_holds[:, 0] + 1, 5),
+            one_hot(who_holds[:, 2] + 1, 5),
+            one_hot(who_holds[:, 1] + 1, 5),
+        ], axis=1)
+
+        policy = self.offense if on_offense else self.defense
+        out, _, _ = policy.compute_actions(obs, explore=False)
+
+        actions, decisions = state.actions()
+        for slot, key in enumerate(("player1", "player2")):
+            act = np.clip(np.asarray(out[key], dtype=np.float32), -1, 1)
+            act[:, 0] = (act[:, 0] + 1) * 15.0
+            act[:, 1] *= np.pi
+            act[:, 3] *= np.pi
+            act[:, 4] = (act[:, 4] + 1) * 25.0
+            actions[:, slot] = torch.from_numpy(act).to(actions)
+            if on_offense:
+                decisions[:, slot] = torch.from_numpy(np.asarray(out["decision"])).to(decisions)
+        return actions, decisions
+
+def load_policy(spec):
+    kind, _, path = spec.partition(":")
+    if kind in SCRIPTED_POLICIES and not path:
+        return SCRIPTED_POLICIES[kind]
+    if kind == "torchscript":
+        return TorchScriptPolicy(path)
+    if kind == "rllib":
+        return RLlibPolicy(path)
+    raise ValueError(f"unknown policy {spec}, expected one of {sorted(SCRIPTED_POLICIES)}, torchscript:<file> or rllib:<checkpoint>")
+
+def load_initial_positions(path):
+    with open(path, 'r') as file:
+        players = json.load(file)["players"][:NUM_PLAYERS]
+    return [[p["x"], p["y"], p["theta"], p["velocity"], p["angular v"], p["facing angle"]] for p in players]
+
+class League:
+    def __init__(self, names, policies, possessions):
+        self.names = names
+        self.policies = policies
+        self.matchups = [(o, d) for o in range(len(names)) for d in range(len(names))]
+        self.target = possessions
+        self.outcomes = [[] for _ in self.matchups]
+        self.in_flight = np.zeros(len(self.matchups), dtype=np.int64)
+
+    def remaining(self):
+        done = np.array([len(o) for o in self.outcomes])
+        return self.target - done - self.in_flight
+
+    def assign(self):
+        # Matchup with the most possessions outstanding, -1 once all are covered
+        remaining = self.remaining()
+        m = int(np.argmax(remaining))
+        if remaining[m] <= 0:
+            return -1
+        self.in_flight[m] += 1
+        return m
+
+    def record(self, matchup, points):
+        self.in_flight[matchup] -= 1
+        if len(self.outcomes[matchup]) < self.target:
+            self.outcomes[matchup].append(points)
+
+def run_seed(args, league, initial_positions, seed, possessions):
+    league.target = possessions
+    league.in_flight[:] = 0
+
+    grid_world = GridWorld(initial_positions, args.num_worlds, args.use_gpu, 0,
+                           seed=seed, scenario_bank=args.scenario_bank)
+    for policy in league.policies:
+        policy.grid_world = grid_world
+    device = grid_world.player_pos.device
+    num_worlds = args.num_worlds
+    shot_clock = int(round(args.shot_clock / D_T))
+
+    matchup = np.array([league.assign() for _ in range(num_worlds)])
+    offense_team = (grid_world.who_holds[:, 0].cpu().numpy() // PLAYERS_PER_TEAM).clip(0, 1)
+    cursor = grid_world.events[:, -1].cpu().numpy().astype(np.int64)
+    ticks = np.zeros(num_worlds, dtype=np.int64)
+    shot_in_air = np.zeros(num_worlds, dtype=bool)
+    pending_reset = np.zeros(num_worlds, dtype=bool)
+    world_ids = np.arange(num_worlds)
+
+    while True:
+        live = (matchup >= 0) & ~pending_reset
+        if not live.any() and not pending_reset.any():
+            break
+
+        # One batched call per (policy, side) over every world it controls
+        offense_policy = np.array([league.matchups[m][0] if m >= 0 else -1 for m in matchup])
+        defense_policy = np.array([league.matchups[m][1] if m >= 0 else -1 for m in matchup])
+        for side, owners, team_of in ((True, offense_policy, offense_team), (False, defense_policy, 1 - offense_team)):
+            for p, policy in enumerate(league.policies):
+                worlds = world_ids[(owners == p) & (matchup >= 0)]
+                if len(worlds) == 0:
+                    continue
+                worlds_t = torch.from_numpy(worlds).to(device)
+                state = TeamState(grid_world, worlds_t, torch.from_numpy(team_of[worlds]).to(device))
+                actions, decisions = policy.act(state, side)
+                grid_world.actions[worlds_t[:, None], state.own_ids] = actions
+                grid_world.choices[worlds_t[:, None], state.own_ids, 0] = decisions
+
+        grid_world.step()
+        ticks += 1
+
+        log = grid_world.events.cpu().numpy()
+        num_emitted = log[:, -1].astype(np.int64)
+        entries = log[:, :-1].reshape(num_worlds, EVENT_LOG_CAPACITY, 4)
+
+        # Worlds flagged last step were reset at the end of this one
+        fresh = world_ids[pending_reset]
+        if len(fresh):
+            pending_reset[fresh] = False
+            cursor[fresh] = num_emitted[fresh]
+            ticks[fresh] = 0
+            shot_in_air[fresh] = False
+            holders = grid_world.who_holds[:, 0].cpu().numpy()
+            offense_team[fresh] = (holders[fresh] // PLAYERS_PER_TEAM).clip(0, 1)
+            for w in fresh:
+                matchup[w] = league.assign()
+
+        ended = np.zeros(num_worlds, dtype=bool)
+        points = np.zeros(num_worlds, dtype=np.int64)
+        first = np.maximum(cursor, num_emitted - EVENT_LOG_CAPACITY)
+        for k in range(int((num_emitted - first)[live].max(initial=0))):
+            idx = first + k
+            valid = live & (idx < num_emitted) & ~ended
+            event = entries[world_ids, idx % EVENT_LOG_CAPACITY]
+            kind, player = event[:, 0], event[:, 2]
+            defensive = (player // PLAYERS_PER_TEAM) != offense_team
+            shot_in_air |= valid & (kind == SHOT)
+            points = np.where(valid & (kind == MAKE), event[:, 3], points)
+            ended |= valid & ((kind == MAKE) | (kind == MISS) | (kind == STEAL) |
+                              ((kind == CATCH) & defensive))
+        cursor = np.where(live, num_emitted, cursor)
+
+        # The shot clock only expires with no shot in the air
+        ended |= live & (ticks >= shot_clock) & ~shot_in_air
+        ended |= live & (ticks >= 2 * shot_clock)
+
+        for w in world_ids[ended]:
+            league.record(matchup[w], int(points[w]))
+            matchup[w] = -1
+            pending_reset[w] = True
+        if ended.any():
+            grid_world.request_reset(torch.from_numpy(world_ids[ended]).to(device))
+
+def mean_ci(values):
+    values = np.asarray(values, dtype=np.float64)
+    if len(values) < 2:
+        return float(values.mean()) if len(values) else float("nan"), float("nan")
+    return values.mean(), 1.96 * values.std(ddof=1) / np.sqrt(len(values))
+
+def head_to_head(a_outcomes, b_outcomes, game_possessions, num_games, rng):
+    # Bootstrapped games of game_possessions possessions per side
+    if len(a_outcomes) == 0 or len(b_outcomes) == 0:
+        return float("nan"), float("nan")
+    a = rng.choice(a_outcomes, (num_games, game_possessions)).sum(axis=1)
+    b = rng.choice(b_outcomes, (num_games, game_possessions)).sum(axis=1)
+    wins = (a > b) + 0.5 * (a == b)
+    return mean_ci(wins)
+
+def print_table(title, names, cell):
+    width = max(14, max(len(n) for n in names) + 2)
+    print(f"\n{title}")
+    print("".ljust(width) + "".join(n.rjust(width) for n in names))
+    for i, row in enumerate(names):
+        print(row.ljust(width) + "".join(cell(i, j).rjust(width) for j in range(len(names))))
+
+def main():
+    arg_parser = argparse.ArgumentParser()
+    arg_parser.add_argument('--policies', nargs='+', default=sorted(SCRIPTED_POLICIES),
+                            help="scripted policy names, torchscript:<file> or rllib:<checkpoint dir>")
+    arg_parser.add_argument('--num_worlds', type=int, default=4096)
+    arg_parser.add_argument('--use_gpu', action='store_true')
+    arg_parser.add_argument('--possessions', type=int, default=1000, help="per matchup, split across seeds")
+    arg_parser.add_argument('--seeds', type=int, nargs='+', default=[0])
+    arg_parser.add_argument('--shot_clock', type=float, default=24.0, help="seconds")
+    arg_parser.add_argument('--game_possessions', type=int, default=50, help="possessions per side in a head to head game")
+    arg_parser.add_argument('--num_games', type=int, default=2000, help="bootstrapped games per pairing")
+    arg_parser.add_argument('--load_state', type=str, default="gamestates/2v2init.json")
+    arg_parser.add_argument('--scenario_bank', type=str, default=None)
+    arg_parser.add_argument('--csv', type=str, default=None, help="write per matchup results here")
+    args = arg_parser.parse_args()
+
+    names = args.policies
+    league = League(names, [load_policy(spec) for spec in names], args.possessions)
+    initial_positions = load_initial_positions(args.load_state)
+
+    start = time.time()
+    per_seed = -(-args.possessions // len(args.seeds))
+    for i, seed in enumerate(args.seeds):
+        run_seed(args, league, initial_positions, seed, min(args.possessions, per_seed * (i + 1)))
+    elapsed = time.time() - start
+
+    total = sum(len(o) for o in league.outcomes)
+    print(f"{total} possessions over {len(league.matchups)} matchups in {elapsed:.1f}s")
+
+    n = len(names)
+    ppp = {league.matchups[m]: mean_ci(league.outcomes[m]) for m in range(len(league.matchups))}
+    print_table("Points per possession (rows offense, columns defense, +- 95% CI)", names,
+                lambda o, d: "{:.3f}+-{:.3f}".format(*ppp[(o, d)]))
+
+    rng = np.random.default_rng(args.seeds[0])
+    index = {pair: m for m, pair in enumerate(league.matchups)}
+    wins = {}
+    for a in range(n):
+        for b in range(n):
+            wins[(a, b)] = head_to_head(league.outcomes[index[(a, b)]], league.outcomes[index[(b, a)]],
+                                        args.game_possessions, args.num_games, rng)
+    print_table(f"Win rate of row vs column over {args.game_possessions} possession games", names,
+                lambda a, b: "{:.3f}+-{:.3f}".format(*wins[(a, b)]))
+
+    print("\nNet points per possession, averaged over opponents")
+    ratings = []
+    for a in range(n):
+        net = [ppp[(a, b)][0] - ppp[(b, a)][0] for b in range(n) if b != a]
+        ratings.append((np.mean(net) if net else 0.0, names[a]))
+    for rating, name in sorted(ratings, reverse=True):
+        print(f"  {name:<32}{rating:+.3f}")
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as file:
+            writer = csv.writer(file)
+            writer.writerow(["offense", "defense", "possessions", "points", "ppp", "ppp_ci", "win_rate", "win_rate_ci"])
+            for m, (o, d) in enumerate(league.matchups):
+                writer.writerow([names[o], names[d], len(league.outcomes[m]), sum(league.outcomes[m]),
+                                 *ppp[(o, d)], *wins[(o, d)]])
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,318 @@
+// Microbenchmarks for the per player physics and rules helpers. Each one
+// runs over a pool of inputs sampled around the compiled gamestates, so
+// branch and cache behavior looks like a real tick, and reports ns/call and
+// throughput. Compile the gamestates into a scenario bank and point the
+// bench_helpers target at it:
+//
+//   cd scripts && python compile_scenarios.py -o bench.bin
+//   build/bench_helpers --scenarios scripts/bench.bin --calls 20000000
+//
+// Without --scenarios the states are drawn uniformly over the court.
+//
+// It also prints Manager::memoryReport, the bytes each world takes per
+// component table and in total. Before the world state was compacted a
+// world took about 6.5 KB, almost all of it a per world std::mt19937 in
+// Sim; the compact layout is about 1.5 KB without the optional exports.
+#include "court_zones.hpp"
+#include "helpers.hpp"
+#include "mgr.hpp"
+#include "scenario_bank.hpp"
+#include "shot_model.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace madsimple;
+
+namespace {
+
+constexpr uint32_t NUM_INPUTS = 4096; // defeats branch history, stays in cache
+constexpr int NUM_REPEATS = 5;
+constexpr float STATE_JITTER = 4.0f; // ft around a gamestate's players
+
+struct BenchArgs {
+    const char *scenarioPath = nullptr;
+    uint64_t calls = 20000000;
+    uint32_t seed = 0;
+};
+
+// One player's state plus the context every helper below needs
+struct PlayerSample {
+    CourtPos pos;
+    Action action;
+    BallState ball;
+    CourtPos opponent; // within PLAYER_COLLISION_DISTANCE of pos
+    int32_t id;
+    int32_t opponentId;
+    int32_t ballOwner;
+    float nearestDefender;
+};
+
+class SampleSource {
+public:
+    SampleSource(const BenchArgs &args)
+        : rng_(args.seed), mapped_(), hasBank_(false)
+    {
+        if (args.scenarioPath != nullptr) {
+            hasBank_ = mapScenarioBank(args.scenarioPath,
+                ScenarioSampling::Uniform, 1, mapped_);
+            if (!hasBank_) {
+                fprintf(stderr, "Failed to load scenario bank %s\n",
+                        args.scenarioPath);
+                exit(1);
+            }
+        }
+    }
+
+    ~SampleSource()
+    {
+        if (hasBank_) {
+            unmapScenarioBank(mapped_);
+        }
+    }
+
+    PlayerSample next()
+    {
+        std::uniform_real_distribution<float> angle(-PI, PI);
+        std::uniform_real_distribution<float> speed(0.f, MAX_PLAYER_SPEED);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::normal_distribution<float> turn(0.f, 2.f);
+
+        PlayerSample s;
+        s.id = std::uniform_int_distribution<int32_t>(
+            0, ACTIVE_PLAYERS - 1)(rng_);
+        s.pos = samplePosition(s.id);
+        // Most players are moving in a tick, a few stand still
+        s.pos.th = angle(rng_);
+        s.pos.v = unit(rng_) < 0.2f ? 0.f : speed(rng_);
+        s.pos.om = turn(rng_);
+        s.pos.facing = angle(rng_);
+
+        s.action = Action {
+            speed(rng_), angle(rng_), turn(rng_), angle(rng_),
+            MACRO_DEFAULT_PASS_SPEED,
+        };
+
+        // Ball positions around the player within twice the wingspan, the
+        // range balltick's sweep hands to the catch test
+        std::uniform_real_distribution<float> offset(-2 * CATCHING_WINGSPAN,
+                                                     2 * CATCHING_WINGSPAN);
+        s.ball = BallState {
+            s.pos.x + offset(rng_), s.pos.y + offset(rng_), angle(rng_),
+            unit(rng_) * 40.f,
+        };
+
+        s.opponentId = (s.id + FIRST_TEAM2_PLAYER) % ACTIVE_PLAYERS;
+        float contact_th = angle(rng_);
+        float contact_r = unit(rng_) * PLAYER_COLLISION_DISTANCE;
+        s.opponent = samplePosition(s.opponentId);
+        s.opponent.x = s.pos.x + contact_r * cosf(contact_th);
+        s.opponent.y = s.pos.y + contact_r * sinf(contact_th);
+        s.opponent.th = angle(rng_);
+        s.opponent.v = unit(rng_) < 0.3f ? 0.f : speed(rng_);
+
+        s.ballOwner = std::uniform_int_distribution<int32_t>(
+            -1, ACTIVE_PLAYERS - 1)(rng_);
+        s.nearestDefender = unit(rng_) * 20.f;
+        return s;
+    }
+
+private:
+    CourtPos samplePosition(int32_t id)
+    {
+        CourtPos pos {};
+        if (!hasBank_) {
+            std::uniform_real_distribution<float> x(MIN_X, MAX_X);
+            std::uniform_real_distribution<float> y(MIN_Y, MAX_Y);
+            pos.x = x(rng_);
+            pos.y = y(rng_);
+            return pos;
+        }
+
+        const ScenarioBank &bank = mapped_.bank;
+        int32_t idx = std::uniform_int_distribution<int32_t>(
+            0, bank.numScenarios - 1)(rng_);
+        const Player &player = bank.scenarios[idx].players[id];
+        std::normal_distribution<float> jitter(0.f, STATE_JITTER);
+        pos.x = std::fmin(std::fmax(player.x + jitter(rng_), MIN_X), MAX_X);
+        pos.y = std::fmin(std::fmax(player.y + jitter(rng_), MIN_Y), MAX_Y);
+        return pos;
+    }
+
+    std::mt19937 rng_;
+    MappedScenarioBank mapped_;
+    bool hasBank_;
+};
+
+// Folded into every result so the calls can't be optimized away
+volatile float benchSink;
+
+inline float sinkValue(float value) { return value; }
+inline float sinkValue(bool value) { return value ? 1.f : 0.f; }
+inline float sinkValue(int value) { return (float)value; }
+inline float sinkValue(FoulID value) { return (float)value; }
+inline float sinkValue(const CourtPos &value)
+{
+    return value.x + value.y + value.facing;
+}
+
+// Best of NUM_REPEATS passes of calls calls each over the input pool
+template <typename Fn>
+void runBench(const char *name, uint64_t calls,
+              const std::vector<PlayerSample> &samples, Fn &&fn)
+{
+    double best_ns = 1e30;
+    float sink = 0.f;
+    for (int rep = 0; rep < NUM_REPEATS; rep++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < calls; i++) {
+            sink += sinkValue(fn(samples[i % NUM_INPUTS]));
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(
+            end - start).count();
+        best_ns = std::min(best_ns, ns);
+    }
+    benchSink = sink;
+
+    double ns_per_call = best_ns / (double)calls;
+    printf("%-28s %10.2f ns/call %10.1f Mcalls/s\n", name, ns_per_call,
+           1e3 / ns_per_call);
+}
+
+void printMemoryReport(const char *label, const Manager::Config &cfg)
+{
+    uint64_t total = 0;
+    printf("Memory per world, %s\n", label);
+    for (const Manager::MemoryUsage &usage : Manager::memoryReport(cfg)) {
+        printf("  %-26s %8llu B\n", usage.name,
+               (unsigned long long)usage.bytesPerWorld);
+        total += usage.bytesPerWorld;
+    }
+    printf("  %-26s %8llu B, %.0f worlds/GiB\n", "total",
+           (unsigned long long)total, (double)(1ull << 30) / (double)total);
+}
+
+bool parseArgs(int argc, char *argv[], BenchArgs &args)
+{
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--scenarios") && has_value) {
+            args.scenarioPath = argv[++i];
+        } else if (!strcmp(argv[i], "--calls") && has_value) {
+            args.calls = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--seed") && has_value) {
+            args.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return args.calls > 0;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    BenchArgs args;
+    if (!parseArgs(argc, argv, args)) {
+        fprintf(stderr, "%s [--scenarios BANK] [--calls N] [--seed S]\n",
+                argv[0]);
+        return 1;
+    }
+
+    std::vector<PlayerSample> samples;
+    samples.reserve(NUM_INPUTS);
+    {
+        SampleSource source(args);
+        for (uint32_t i = 0; i < NUM_INPUTS; i++) {
+            samples.push_back(source.next());
+        }
+    }
+
+    ShotModel shot_model;
+    buildDefaultShotModel(shot_model);
+    CourtZoneGrid court_zones;
+    buildCourtZoneGrid(court_zones);
+    const StaticPlayerAttributes attributes {
+        DEFAULT_THREE_POINT_PCT, DEFAULT_FIELD_GOAL_PCT,
+        DEFAULT_RUNNING_SPEED_MPH,
+    };
+    const float stepdt = D_T / COLLISION_CHECK_STEPS;
+    uint64_t calls = args.calls;
+
+    Manager::Config mem_cfg {};
+    printMemoryReport("default config", mem_cfg);
+    mem_cfg.enableRaster = true;
+    mem_cfg.observationPrecision = ObservationPrecision::Float16;
+    mem_cfg.observationHistory = true;
+    printMemoryReport("raster, fp16 state and observation history", mem_cfg);
+
+    printf("%u inputs from %s, %llu calls per pass, best of %d\n",
+           NUM_INPUTS, args.scenarioPath ? args.scenarioPath : "uniform court",
+           (unsigned long long)calls, NUM_REPEATS);
+
+    runBench("updateCourtPositionStepped", calls, samples,
+             [&](const PlayerSample &s) {
+        return updateCourtPositionStepped(s.pos, s.action, stepdt);
+    });
+    runBench("cancelPrevMovementStep", calls, samples,
+             [&](const PlayerSample &s) {
+        return cancelPrevMovementStep(s.pos, s.action, stepdt);
+    });
+    runBench("shouldPlayerCatch", calls, samples,
+             [&](const PlayerSample &s) {
+        BallState ball = s.ball;
+        CourtPos pos = s.pos;
+        return shouldPlayerCatch(&ball, pos);
+    });
+    runBench("probabilityOfShot", calls, samples,
+             [&](const PlayerSample &s) {
+        float hoop_x = s.id < FIRST_TEAM2_PLAYER ? LEFT_HOOP_X : RIGHT_HOOP_X;
+        float distance = calculateDistance(s.pos.x, s.pos.y, hoop_x,
+                                           LEFT_HOOP_Y);
+        return probabilityOfShot(shot_model, distance, hoop_x, LEFT_HOOP_Y,
+            s.pos, s.nearestDefender, attributes,
+            distance > 23.75f);
+    });
+    runBench("isThreePointer", calls, samples,
+             [&](const PlayerSample &s) {
+        float hoop_x = s.id < FIRST_TEAM2_PLAYER ? LEFT_HOOP_X : RIGHT_HOOP_X;
+        return isThreePointer(s.pos.x, s.pos.y, hoop_x);
+    });
+    runBench("findClosestInbound", calls, samples,
+             [&](const PlayerSample &s) {
+        BallState ball = s.ball;
+        return findClosestInbound(court_zones, ball);
+    });
+    runBench("exactClosestInbound", calls, samples,
+             [&](const PlayerSample &s) {
+        return (int)exactClosestInbound(s.ball.x, s.ball.y);
+    });
+    runBench("ballIsOOB", calls, samples,
+             [&](const PlayerSample &s) {
+        BallState ball = s.ball;
+        return ballIsOOB(court_zones, ball);
+    });
+    runBench("exactCourtZone", calls, samples,
+             [&](const PlayerSample &s) {
+        return (int)exactCourtZone(s.pos.x, s.pos.y);
+    });
+    runBench("lookupCourtZone", calls, samples,
+             [&](const PlayerSample &s) {
+        return (int)lookupCourtZone(court_zones, s.pos.x, s.pos.y);
+    });
+    runBench("collisionFoul", calls, samples,
+             [&](const PlayerSample &s) {
+        return collisionFoul(s.pos, s.id, s.opponent, s.opponentId,
+                             s.ballOwner);
+    });
+
+    return 0;
+}
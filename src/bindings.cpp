@@ -1,8 +1,19 @@
 #include "mgr.hpp"
+#include "replay_buffer.hpp"
 
 #include <madrona/macros.hpp>
 #include <madrona/py/bindings.hpp>
 
+#include <nanobind/stl/optional.h>
+#include <nanobind/stl/string.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 namespace madsimple {
 
 // New function, takes in player objects by reference, and updates players with given positions, and assigns them an index
@@ -20,17 +31,60 @@ static void setPositions(Player *players, const float *positions, int64_t num_pl
 }
 
 // Wrapper function to call helpers, and return our Player array object
-static Player * setupPlayerData(
+static std::vector<Player> setupPlayerData(
     const nb::ndarray<float, nb::shape<-1, 6>,
         nb::c_contig, nb::device::cpu> &init_player_pos,
     int64_t num_players)
 
 {
-    Player *players = new Player[num_players]();
-    setPositions(players, init_player_pos.data(), num_players);
+    std::vector<Player> players(num_players);
+    setPositions(players.data(), init_player_pos.data(), num_players);
     return players;
 }
 
+// The randomization spec is all floats, so Python packs it flat in field order
+static CourtRandomization setupRandomization(
+    const nb::ndarray<float, nb::shape<-1>,
+        nb::c_contig, nb::device::cpu> &spec)
+{
+    constexpr size_t num_floats = sizeof(CourtRandomization) / sizeof(float);
+    if (spec.shape(0) != num_floats) {
+        throw std::runtime_error("randomization spec must have " +
+            std::to_string(num_floats) + " floats");
+    }
+
+    CourtRandomization randomization;
+    memcpy(&randomization, spec.data(), sizeof(CourtRandomization));
+
+    float total = 0.f;
+    for (float weight : randomization.ballHolderWeights) {
+        if (!(weight >= 0.f) || !std::isfinite(weight)) {
+            throw std::runtime_error(
+                "ball_holder_weights must be finite and non-negative");
+        }
+        total += weight;
+    }
+    if (total <= 0.f) {
+        throw std::runtime_error(
+            "ball_holder_weights must have at least one positive weight");
+    }
+
+    return randomization;
+}
+
+using ReplayRows = nb::ndarray<float, nb::ndim<2>, nb::c_contig, nb::device::cpu>;
+using ReplayScalars = nb::ndarray<float, nb::ndim<1>, nb::c_contig, nb::device::cpu>;
+using ReplayDiscrete = nb::ndarray<int32_t, nb::ndim<2>, nb::c_contig, nb::device::cpu>;
+
+static void checkReplayColumn(const char *name, size_t rows, size_t expected_rows,
+                              size_t cols, size_t expected_cols)
+{
+    if (rows != expected_rows || cols != expected_cols) {
+        throw std::runtime_error(std::string("replay buffer ") + name +
+            " must be [" + std::to_string(expected_rows) + ", " +
+            std::to_string(expected_cols) + "]");
+    }
+}
 
 NB_MODULE(_madrona_simple_example_cpp, m) {
     madrona::py::setupMadronaSubmodule(m);
@@ -44,11 +98,54 @@ NB_MODULE(_madrona_simple_example_cpp, m) {
                             madrona::py::PyExecMode exec_mode,
                             int64_t num_worlds,
                             int64_t num_players, // given number of players (need to decide if we include all players or just playing players)
-                            int64_t gpu_id) {
+                            int64_t gpu_id,
+                            const std::string &shot_model_path,
+                            std::optional<nb::ndarray<float, nb::shape<-1>,
+                                nb::c_contig, nb::device::cpu>> randomization,
+                            int64_t seed,
+                            const std::string &scenario_bank_path,
+                            int64_t scenario_sampling,
+                            int64_t curriculum_episodes_per_stage,
+                            bool enable_raster,
+                            int64_t raster_width,
+                            int64_t raster_height,
+                            const std::string &shared_memory_name,
+                            bool shared_memory_actions,
+                            bool deterministic,
+                            int64_t num_threads,
+                            bool adaptive_substeps,
+                            int64_t observation_precision,
+                            bool lazy_init,
+                            std::optional<nb::ndarray<float,
+                                nb::shape<-1, -1, 6>, nb::c_contig,
+                                nb::device::cpu>> initial_states,
+                            bool observation_history,
+                            bool team_canonical) {
 
 
             
-            Player *players = setupPlayerData(init_player_pos, num_players); // call our player data setup function
+            std::vector<Player> players = setupPlayerData(init_player_pos, num_players); // call our player data setup function
+
+            if (initial_states.has_value() &&
+                    (initial_states->shape(0) != (size_t)num_worlds ||
+                     initial_states->shape(1) != ACTIVE_PLAYERS)) {
+                throw std::runtime_error("initial_states must be [" +
+                    std::to_string(num_worlds) + ", " +
+                    std::to_string(ACTIVE_PLAYERS) + ", 6]");
+            }
+
+            // Mirrors usesLazyInit in mgr.cpp, anywhere else the states
+            // would be dropped
+            if (initial_states.has_value() && (!lazy_init ||
+                    randomization.has_value() || !scenario_bank_path.empty())) {
+                throw std::runtime_error("initial_states needs lazy_init and "
+                    "can't be combined with randomization or a scenario bank");
+            }
+
+            CourtRandomization court_randomization;
+            if (randomization.has_value()) {
+                court_randomization = setupRandomization(*randomization);
+            }
 
             new (self) Manager(Manager::Config {
                 .maxEpisodeLength = (uint32_t)max_episode_length,
@@ -56,12 +153,33 @@ NB_MODULE(_madrona_simple_example_cpp, m) {
                 .numWorlds = (uint32_t)num_worlds,
                 .numPlayers = (uint32_t)num_players, // new, passing in num_players to config
                 .gpuID = (int)gpu_id,
+                .shotModelPath = shot_model_path.c_str(),
+                .randomization = randomization.has_value() ?
+                    &court_randomization : nullptr,
+                .seed = (uint32_t)seed,
+                .scenarioBankPath = scenario_bank_path.c_str(),
+                .scenarioSampling = (ScenarioSampling)scenario_sampling,
+                .curriculumEpisodesPerStage =
+                    (uint32_t)curriculum_episodes_per_stage,
+                .enableRaster = enable_raster,
+                .rasterWidth = (uint32_t)raster_width,
+                .rasterHeight = (uint32_t)raster_height,
+                .sharedMemoryName = shared_memory_name.c_str(),
+                .sharedMemoryActions = shared_memory_actions,
+                .deterministic = deterministic,
+                .numThreads = (uint32_t)num_threads,
+                .adaptiveSubsteps = adaptive_substeps,
+                .observationPrecision =
+                    (ObservationPrecision)observation_precision,
+                .lazyInit = lazy_init,
+                .initialPlayerStates = initial_states.has_value() ?
+                    initial_states->data() : nullptr,
+                .observationHistory = observation_history,
+                .teamCanonical = team_canonical,
             }, CourtState { // new, passing in our court state to the manager
-                .players = players,
+                .players = players.data(),
                 .numPlayers = (int32_t)num_players
             });
-
-            delete[] players;
         }, // nb::arg("walls"),
         //    nb::arg("rewards"),
         //    nb::arg("end_cells"),
@@ -72,7 +190,26 @@ NB_MODULE(_madrona_simple_example_cpp, m) {
            nb::arg("exec_mode"),
            nb::arg("num_worlds"),
            nb::arg("num_players"), // arg for number of players
-           nb::arg("gpu_id") = -1)
+           nb::arg("gpu_id") = -1,
+           nb::arg("shot_model_path") = "",
+           nb::arg("randomization") = nb::none(),
+           nb::arg("seed") = 0,
+           nb::arg("scenario_bank_path") = "",
+           nb::arg("scenario_sampling") = 0,
+           nb::arg("curriculum_episodes_per_stage") = 1000,
+           nb::arg("enable_raster") = false,
+           nb::arg("raster_width") = 48,
+           nb::arg("raster_height") = 26,
+           nb::arg("shared_memory_name") = "",
+           nb::arg("shared_memory_actions") = false,
+           nb::arg("deterministic") = false,
+           nb::arg("num_threads") = 0,
+           nb::arg("adaptive_substeps") = true,
+           nb::arg("observation_precision") = 0,
+           nb::arg("lazy_init") = false,
+           nb::arg("initial_states") = nb::none(),
+           nb::arg("observation_history") = false,
+           nb::arg("team_canonical") = false)
         .def("step", &Manager::step)
         .def("reset_tensor", &Manager::resetTensor)
         .def("player_tensor", &Manager::playerTensor) // added new player tensor for data export
@@ -82,7 +219,166 @@ NB_MODULE(_madrona_simple_example_cpp, m) {
         .def("scorecard_tensor", &Manager::gameStateTensor)
         .def("choice_tensor", &Manager::choiceTensor)
         .def("foul_call_tensor", &Manager::foulCallTensor)
+        .def("player_attributes_tensor", &Manager::playerAttributesTensor)
+        .def("scenario_tensor", &Manager::scenarioTensor)
+        .def("raster_tensor", &Manager::rasterTensor)
+        .def("event_tensor", &Manager::eventTensor)
+        .def("box_score_tensor", &Manager::boxScoreTensor)
+        .def("state_hash_tensor", &Manager::stateHashTensor)
+        .def("substep_stats_tensor", &Manager::substepStatsTensor)
+        .def("active_tensor", &Manager::activeTensor)
+        .def("macro_command_tensor", &Manager::macroCommandTensor)
+        .def("macro_params_tensor", &Manager::macroParamsTensor)
+        .def("quantized_state_tensor", &Manager::quantizedStateTensor)
+        .def("observation_history_tensor", &Manager::observationHistoryTensor)
+        .def("pairwise_geometry_tensor", &Manager::pairwiseGeometryTensor)
+        .def("court_zone_tensor", &Manager::courtZoneTensor)
+        .def("box_score_totals", &Manager::boxScoreTotals, nb::arg("reset") = false)
+        .def("start_rollout", &Manager::startRollout, nb::arg("horizon"))
+        .def("rollout_steps", &Manager::rolloutSteps)
+        .def("compute_advantages", &Manager::computeAdvantages,
+             nb::arg("gamma") = 0.99f, nb::arg("lam") = 0.95f)
+        .def("rollout_observations", &Manager::rolloutObservations)
+        .def("rollout_actions", &Manager::rolloutActions)
+        .def("rollout_choices", &Manager::rolloutChoices)
+        .def("rollout_rewards", &Manager::rolloutRewards)
+        .def("rollout_dones", &Manager::rolloutDones)
+        .def("rollout_active", &Manager::rolloutActive)
+        .def("rollout_values", &Manager::rolloutValues)
+        .def("rollout_advantages", &Manager::rolloutAdvantages)
+        .def("rollout_returns", &Manager::rolloutReturns)
+        .def("policy_id_tensor", &Manager::policyIdTensor)
+        .def("gather_policy_batches", &Manager::gatherPolicyBatches,
+             nb::arg("num_policies"))
+        .def("scatter_policy_batches", &Manager::scatterPolicyBatches)
+        .def("policy_offsets", &Manager::policyOffsets)
+        .def("policy_observations", &Manager::policyObservations)
+        .def("policy_actions", &Manager::policyActions)
+        .def("policy_choices", &Manager::policyChoices)
+        .def("policy_slots", &Manager::policySlots)
+        .def("memory_report", [](const Manager &mgr) {
+            nb::dict report;
+            for (const Manager::MemoryUsage &usage : mgr.memoryReport()) {
+                report[usage.name] = usage.bytesPerWorld;
+            }
+            return report;
+        })
+        .def_static("save_default_shot_model", [](const std::string &path) {
+            Manager::saveDefaultShotModel(path.c_str());
+        })
     ;
+
+    nb::class_<ReplayBuffer> (m, "ReplayBuffer")
+        .def("__init__", [](ReplayBuffer *self,
+                            int64_t capacity,
+                            int64_t state_dim,
+                            int64_t cont_action_dim,
+                            int64_t disc_action_dim,
+                            int64_t max_batch_size,
+                            bool prioritized,
+                            float alpha,
+                            float epsilon,
+                            int64_t seed) {
+            new (self) ReplayBuffer(ReplayBuffer::Config {
+                .capacity = (uint32_t)capacity,
+                .stateDim = (uint32_t)state_dim,
+                .contActionDim = (uint32_t)cont_action_dim,
+                .discActionDim = (uint32_t)disc_action_dim,
+                .maxBatchSize = (uint32_t)max_batch_size,
+                .prioritized = prioritized,
+                .alpha = alpha,
+                .epsilon = epsilon,
+                .seed = (uint32_t)seed,
+            });
+        }, nb::arg("capacity"),
+           nb::arg("state_dim"),
+           nb::arg("cont_action_dim"),
+           nb::arg("disc_action_dim") = 0,
+           nb::arg("max_batch_size") = 256,
+           nb::arg("prioritized") = false,
+           nb::arg("alpha") = 0.6f,
+           nb::arg("epsilon") = 1e-6f,
+           nb::arg("seed") = 0)
+        // Every argument is [N, ...] for N transitions, e.g. one per world
+        .def("add", [](ReplayBuffer &buffer,
+                       const ReplayRows &state,
+                       const ReplayRows &cont_action,
+                       std::optional<ReplayDiscrete> disc_action,
+                       const ReplayScalars &reward,
+                       const ReplayRows &next_state,
+                       const ReplayScalars &done) {
+            const ReplayBuffer::Config &cfg = buffer.config();
+            size_t state_dim = cfg.stateDim;
+            size_t cont_action_dim = cfg.contActionDim;
+            size_t disc_action_dim = cfg.discActionDim;
+
+            size_t num_rows = state.shape(0);
+            checkReplayColumn("state", num_rows, num_rows,
+                              state.shape(1), state_dim);
+            checkReplayColumn("cont_action", cont_action.shape(0), num_rows,
+                              cont_action.shape(1), cont_action_dim);
+            checkReplayColumn("next_state", next_state.shape(0), num_rows,
+                              next_state.shape(1), state_dim);
+            checkReplayColumn("reward", reward.shape(0), num_rows, 1, 1);
+            checkReplayColumn("done", done.shape(0), num_rows, 1, 1);
+            if (disc_action_dim > 0) {
+                if (!disc_action.has_value()) {
+                    throw std::runtime_error(
+                        "replay buffer needs disc_action");
+                }
+                checkReplayColumn("disc_action", disc_action->shape(0),
+                    num_rows, disc_action->shape(1), disc_action_dim);
+            }
+
+            buffer.add((uint32_t)num_rows, state.data(), cont_action.data(),
+                       disc_action_dim > 0 ? disc_action->data() : nullptr,
+                       reward.data(), next_state.data(), done.data());
+        }, nb::arg("state"),
+           nb::arg("cont_action"),
+           nb::arg("disc_action").none() = nb::none(),
+           nb::arg("reward"),
+           nb::arg("next_state"),
+           nb::arg("done"))
+        // Returns (state, cont_action, disc_action, reward, next_state,
+        // done, indices, weights), overwritten by the next sample
+        .def("sample", [](ReplayBuffer &buffer, int64_t batch_size,
+                          float beta) {
+            uint32_t n = (uint32_t)batch_size;
+            buffer.sample(n, beta);
+            return nb::make_tuple(buffer.stateBatch(n),
+                                  buffer.contActionBatch(n),
+                                  buffer.discActionBatch(n),
+                                  buffer.rewardBatch(n),
+                                  buffer.nextStateBatch(n),
+                                  buffer.doneBatch(n),
+                                  buffer.indexBatch(n),
+                                  buffer.weightBatch(n));
+        }, nb::arg("batch_size"), nb::arg("beta") = 0.4f)
+        .def("update_priorities", [](ReplayBuffer &buffer,
+                nb::ndarray<int64_t, nb::ndim<1>, nb::c_contig,
+                    nb::device::cpu> indices,
+                const ReplayScalars &priorities) {
+            if (indices.shape(0) != priorities.shape(0)) {
+                throw std::runtime_error(
+                    "indices and priorities must be the same length");
+            }
+            buffer.updatePriorities((uint32_t)indices.shape(0),
+                                    indices.data(), priorities.data());
+        }, nb::arg("indices"), nb::arg("priorities"))
+        .def("__len__", &ReplayBuffer::size)
+    ;
+
+    // Ordered access to the shared memory export's sequence counters for
+    // shared.py, numpy has no atomics. Addresses are raw integers from
+    // ndarray.ctypes.data.
+    m.def("atomic_load_acquire_u64", [](uintptr_t address) {
+        return std::atomic_ref<uint64_t>(*(uint64_t *)address)
+            .load(std::memory_order_acquire);
+    });
+    m.def("atomic_store_release_u64", [](uintptr_t address, uint64_t value) {
+        std::atomic_ref<uint64_t>(*(uint64_t *)address)
+            .store(value, std::memory_order_release);
+    });
 }
 
 }
@@ -43,7 +43,13 @@ constexpr double GRAVITY = 32.1741;
 constexpr double MAX_V_CHANGE = 50.0;
 
 constexpr int ACTIVE_PLAYERS = 4;
+// Most movement/collision substeps per tick. With adaptive substepping each
+// world runs just enough that no pair closes more than SUBSTEP_MAX_CLOSING
+// per substep, and a single one when no pair can collide this tick.
 constexpr int COLLISION_CHECK_STEPS = 4;
+constexpr float SUBSTEP_MAX_CLOSING = 0.75; // 2 players at full speed over D_T / 4
+constexpr float PLAYER_COLLISION_DISTANCE = 1.5;
+constexpr float MAX_PLAYER_SPEED = 30.0;
 
 
 constexpr int PLAYER_STARTING_WITH_BALL = 2;
@@ -55,6 +61,18 @@ constexpr double DECAY_FACTOR = 0.025;
 
 constexpr double CATCHING_WINGSPAN = 2.75;
 
+// Macro action controllers
+constexpr float MACRO_ARRIVE_RADIUS = 0.5; // MOVE_TO is done within this of the target
+constexpr float MACRO_TURN_GAIN = 5.0; // omdes per radian of facing error
+constexpr float MACRO_DEFAULT_PASS_SPEED = 35.0;
+
+// Swept ball collision radii, see sweptCircleTOI. A shot scores or rebounds
+// when its path passes within the capture radius of the hoop, and a pass or
+// loose ball goes to the first player whose radius it enters: the pickup
+// radius, or CATCHING_WINGSPAN for a player in position to catch it.
+constexpr float HOOP_CAPTURE_RADIUS = 0.75;
+constexpr float LOOSE_BALL_PICKUP_RADIUS = 2.0;
+
 // used for calculating if pass/loose ball can be caught
 // assumption is that if your direction is less than 45 degree away from ball
 // than you can't catch it (as your back is facing the ball)
@@ -66,6 +84,40 @@ constexpr float RIGHT_INBOUND_X = 40.0;
 constexpr float LEFT_INBOUND_Y = 10;
 constexpr float RIGHT_INBOUND_Y = -10;
 
+// League average player attributes, used when a roster doesn't provide them
+constexpr float DEFAULT_THREE_POINT_PCT = 36.0f;
+constexpr float DEFAULT_FIELD_GOAL_PCT = 47.0f;
+constexpr float DEFAULT_RUNNING_SPEED_MPH = 20.45f; // ~30 ft/s, the vdes cap
+
+// Per world game event ring buffer, consumers must read at least this many
+// events between steps or the oldest ones are overwritten
+constexpr int EVENT_LOG_CAPACITY = 32;
+
+// Top-down raster observation: occupancy disks for each team, the ball and
+// the hoops, plus player velocity encoded around 128
+constexpr int RASTER_NUM_CHANNELS = 6;
+constexpr float RASTER_PLAYER_RADIUS = 1.5;
+constexpr float RASTER_BALL_RADIUS = 0.75;
+constexpr float RASTER_HOOP_RADIUS = 0.75;
+constexpr float RASTER_MAX_SPEED = 30.0; // maps to 0 / 255 in the velocity channels
+
+// Fixed point scales (counts per unit) of the int16 state export. Values
+// are stored as round(value * scale) saturated to +-32767, angles are
+// wrapped to [-pi, pi) first.
+constexpr float QUANT_POSITION_SCALE = 512.0f; // ft, covers +-64
+constexpr float QUANT_ANGLE_SCALE = 8192.0f; // rad, covers +-4
+constexpr float QUANT_SPEED_SCALE = 512.0f; // ft/s, covers +-64
+constexpr float QUANT_ANGULAR_SCALE = 1024.0f; // rad/s, covers +-32
+// Players (x, y, th, v, om, facing), ball (x, y, th, v), then actions
+// (vdes, thdes, omdes, pass_th, pass_v)
+constexpr int QUANT_STATE_WIDTH = ACTIVE_PLAYERS * 6 + 4 + ACTIVE_PLAYERS * 5;
+
+// Observation row the rollout collector stores per world: CourtPos for
+// every player, then BallState, BallStatus and Scorecard (ints as floats)
+constexpr int ROLLOUT_OBS_DIM = ACTIVE_PLAYERS * 6 + 4 + 4 + 4;
+// Frames kept per world by the optional observation history
+constexpr int OBS_HISTORY_FRAMES = 4;
+
 // constexpr char ASSET_PATH[] = "assets/";
 // constexpr char CONFIG_FILE[] = "config/settings.cfg";
 
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstdint>
+
+#include "consts.hpp"
+
 // New File, which delcares our Player struct and CourtState struct for internal data management
 // This is different than defining archetypes for actually running the madrona simulator
 namespace madsimple {
@@ -18,4 +22,45 @@ struct CourtState {
     Player *players;
     int32_t numPlayers;
 };
+
+// Inclusive sampling range, min == max pins the value
+struct ValueRange {
+    float min;
+    float max;
+};
+
+struct PlayerRandomization {
+    ValueRange x;
+    ValueRange y;
+    ValueRange th;
+    ValueRange v;
+    ValueRange facing;
+};
+
+struct AttributeRandomization {
+    ValueRange shootingPercentage3Points;
+    ValueRange shootingPercentageFieldGoal;
+    ValueRange runningSpeedMph;
+};
+
+// Initial state distribution sampled by every world at construction and on
+// each reset, replacing the fixed CourtState. Only floats so Python can pack
+// it as a flat array (see make_randomization in gridworld.py).
+struct CourtRandomization {
+    PlayerRandomization players[ACTIVE_PLAYERS];
+    // Relative chance of each player starting with the ball, the last entry
+    // is the chance of the ball starting loose at center court. The manager
+    // turns them into running sums on the host, so the copy worlds see is
+    // sampled with one uniform draw.
+    float ballHolderWeights[ACTIVE_PLAYERS + 1];
+    AttributeRandomization attributes;
+};
+
+// Element type of the optional reduced precision state export, Float32
+// leaves it disabled. Int16 scales are the QUANT_* constants.
+enum class ObservationPrecision : int32_t {
+    Float32 = 0,
+    Float16 = 1,
+    Int16 = 2,
+};
 }
@@ -0,0 +1,166 @@
+#include "court_zones.hpp"
+
+#include <algorithm>
+
+namespace madsimple {
+
+namespace {
+
+// Cells are classified a hair larger than they are, so float rounding in
+// the lookup's index math can't land a point in a cell that doesn't cover it
+constexpr double CELL_PAD = 1e-3;
+
+// Whether a test holds at every point of a cell, at none, or only some
+enum class Coverage { None, All, Some };
+
+Coverage coverage(bool all, bool none)
+{
+    return all ? Coverage::All : (none ? Coverage::None : Coverage::Some);
+}
+
+// value > t over value in [lo, hi]
+Coverage above(double lo, double hi, double t)
+{
+    return coverage(lo > t, hi <= t);
+}
+
+// value < t over value in [lo, hi]
+Coverage below(double lo, double hi, double t)
+{
+    return coverage(hi < t, lo >= t);
+}
+
+Coverage coverOr(Coverage a, Coverage b)
+{
+    return coverage(a == Coverage::All || b == Coverage::All,
+                    a == Coverage::None && b == Coverage::None);
+}
+
+Coverage coverAnd(Coverage a, Coverage b)
+{
+    return coverage(a == Coverage::All && b == Coverage::All,
+                    a == Coverage::None || b == Coverage::None);
+}
+
+Coverage coverNot(Coverage a)
+{
+    return coverage(a == Coverage::None, a == Coverage::All);
+}
+
+struct Cell {
+    double x0, x1, y0, y1;
+
+    // Closest and farthest distance from (px, py) to the cell
+    double minDistance(double px, double py) const
+    {
+        double dx = std::max({x0 - px, 0.0, px - x1});
+        double dy = std::max({y0 - py, 0.0, py - y1});
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    double maxDistance(double px, double py) const
+    {
+        double dx = std::max(std::abs(px - x0), std::abs(px - x1));
+        double dy = std::max(std::abs(py - y0), std::abs(py - y1));
+        return std::sqrt(dx * dx + dy * dy);
+    }
+};
+
+// Same tests as exactCourtZone, over a whole cell
+Coverage coverCorner(const Cell &c)
+{
+    return coverOr(above(c.y0, c.y1, MAX_Y - CORNER_THREE_DEPTH),
+                   below(c.y0, c.y1, MIN_Y + CORNER_THREE_DEPTH));
+}
+
+Coverage coverArc(const Cell &c, double hoop_x)
+{
+    return above(c.minDistance(hoop_x, LEFT_HOOP_Y),
+                 c.maxDistance(hoop_x, LEFT_HOOP_Y), THREE_POINT_RADIUS);
+}
+
+uint8_t classifyZone(const Cell &c)
+{
+    Coverage three_left = coverOr(coverArc(c, LEFT_HOOP_X), coverCorner(c));
+    Coverage three_right = coverOr(coverArc(c, RIGHT_HOOP_X), coverCorner(c));
+
+    Coverage left_half = below(c.x0, c.x1, CENTER_X);
+    Coverage corner = coverAnd(coverCorner(c), coverOr(
+        coverAnd(left_half, coverNot(coverArc(c, LEFT_HOOP_X))),
+        coverAnd(coverNot(left_half), coverNot(coverArc(c, RIGHT_HOOP_X)))));
+
+    Coverage paint = coverAnd(
+        coverOr(below(c.x0, c.x1, MIN_X + PAINT_LENGTH),
+                above(c.x0, c.x1, MAX_X - PAINT_LENGTH)),
+        coverAnd(above(c.y0, c.y1, -PAINT_HALF_WIDTH),
+                 below(c.y0, c.y1, PAINT_HALF_WIDTH)));
+
+    const Coverage tests[] = { three_left, three_right, corner, paint };
+    const uint32_t bits[] = {
+        COURT_ZONE_THREE_LEFT, COURT_ZONE_THREE_RIGHT,
+        COURT_ZONE_CORNER, COURT_ZONE_PAINT,
+    };
+
+    uint8_t zone = 0;
+    for (int i = 0; i < 4; i++) {
+        if (tests[i] == Coverage::Some) {
+            return CourtZoneGrid::CELL_EXACT;
+        }
+        if (tests[i] == Coverage::All) {
+            zone |= (uint8_t)bits[i];
+        }
+    }
+    return zone;
+}
+
+// An inbound point owns the cell when even its farthest corner is closer
+// than every other point gets to the cell
+uint8_t classifyInbound(const Cell &c)
+{
+    constexpr int32_t num_points = (int32_t)INBOUND_POINTS.size();
+    double near[num_points], far[num_points];
+    for (int32_t i = 0; i < num_points; i++) {
+        near[i] = c.minDistance(INBOUND_POINTS[i].x, INBOUND_POINTS[i].y);
+        far[i] = c.maxDistance(INBOUND_POINTS[i].x, INBOUND_POINTS[i].y);
+    }
+
+    for (int32_t i = 0; i < num_points; i++) {
+        bool owns = true;
+        for (int32_t j = 0; j < num_points; j++) {
+            if (j != i && far[i] >= near[j]) {
+                owns = false;
+                break;
+            }
+        }
+        if (owns) {
+            return (uint8_t)i;
+        }
+    }
+    return CourtZoneGrid::CELL_EXACT;
+}
+
+}
+
+void buildCourtZoneGrid(CourtZoneGrid &grid)
+{
+    static_assert(CourtZoneGrid::WIDTH * CourtZoneGrid::CELL_SIZE ==
+                  COURT_WIDTH);
+    static_assert(CourtZoneGrid::HEIGHT * CourtZoneGrid::CELL_SIZE ==
+                  COURT_HEIGHT);
+
+    constexpr double size = CourtZoneGrid::CELL_SIZE;
+    for (int32_t cy = 0; cy < CourtZoneGrid::HEIGHT; cy++) {
+        for (int32_t cx = 0; cx < CourtZoneGrid::WIDTH; cx++) {
+            Cell cell {
+                MIN_X + cx * size - CELL_PAD,
+                MIN_X + (cx + 1) * size + CELL_PAD,
+                MIN_Y + cy * size - CELL_PAD,
+                MIN_Y + (cy + 1) * size + CELL_PAD,
+            };
+            grid.zones[cy][cx] = classifyZone(cell);
+            grid.inbound[cy][cx] = classifyInbound(cell);
+        }
+    }
+}
+
+}
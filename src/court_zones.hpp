@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+#include "consts.hpp"
+
+namespace madsimple {
+
+// Zone bits of a court point. A spot can be a three at one end of the
+// court and a two at the other, so the three point bit is per hoop.
+constexpr uint32_t COURT_ZONE_OOB = 1 << 0;
+constexpr uint32_t COURT_ZONE_THREE_LEFT = 1 << 1; // shooting at LEFT_HOOP_X
+constexpr uint32_t COURT_ZONE_THREE_RIGHT = 1 << 2; // shooting at RIGHT_HOOP_X
+constexpr uint32_t COURT_ZONE_CORNER = 1 << 3; // a three only by the corner rule
+constexpr uint32_t COURT_ZONE_PAINT = 1 << 4;
+
+constexpr float THREE_POINT_RADIUS = 23.75f; // 23'9'' from the hoop
+constexpr float CORNER_THREE_DEPTH = 3.0f; // ft in from the sideline
+constexpr float PAINT_LENGTH = 19.0f; // ft out from the baseline
+constexpr float PAINT_HALF_WIDTH = 8.0f;
+
+// Exact point tests. The grid below is built from these and falls back to
+// them, so a lookup always agrees with the math.
+inline bool isOutOfBounds(float x, float y)
+{
+    return !((x > MIN_X) && (x < MAX_X) && (y > MIN_Y) && (y < MAX_Y));
+}
+
+inline bool isThreePointSpot(float x, float y, float hoop_x)
+{
+    float dx = hoop_x - x;
+    float dy = (float)LEFT_HOOP_Y - y;
+    return (std::sqrt(dx * dx + dy * dy) > THREE_POINT_RADIUS)
+        || (y > MAX_Y - CORNER_THREE_DEPTH) // top corner three
+        || (y < MIN_Y + CORNER_THREE_DEPTH); // bottom corner three
+}
+
+inline uint32_t exactCourtZone(float x, float y)
+{
+    uint32_t zone = 0;
+    if (isOutOfBounds(x, y)) {
+        zone |= COURT_ZONE_OOB;
+    }
+    if (isThreePointSpot(x, y, LEFT_HOOP_X)) {
+        zone |= COURT_ZONE_THREE_LEFT;
+    }
+    if (isThreePointSpot(x, y, RIGHT_HOOP_X)) {
+        zone |= COURT_ZONE_THREE_RIGHT;
+    }
+
+    // Measured against the hoop on the point's own half
+    float hoop_x = x < CENTER_X ? LEFT_HOOP_X : RIGHT_HOOP_X;
+    float dx = hoop_x - x;
+    float dy = (float)LEFT_HOOP_Y - y;
+    bool in_corner = (y > MAX_Y - CORNER_THREE_DEPTH) ||
+        (y < MIN_Y + CORNER_THREE_DEPTH);
+    if (in_corner && std::sqrt(dx * dx + dy * dy) <= THREE_POINT_RADIUS) {
+        zone |= COURT_ZONE_CORNER;
+    }
+
+    if ((x < MIN_X + PAINT_LENGTH || x > MAX_X - PAINT_LENGTH) &&
+            y > -PAINT_HALF_WIDTH && y < PAINT_HALF_WIDTH) {
+        zone |= COURT_ZONE_PAINT;
+    }
+
+    return zone;
+}
+
+// Index into INBOUND_POINTS, the first one wins a tie
+inline int32_t exactClosestInbound(float x, float y)
+{
+    int32_t closest = 0;
+    float min_distance = INFINITY;
+    for (int32_t i = 0; i < (int32_t)INBOUND_POINTS.size(); i++) {
+        float dx = x - (float)INBOUND_POINTS[i].x;
+        float dy = y - (float)INBOUND_POINTS[i].y;
+        float distance = std::sqrt(dx * dx + dy * dy);
+        if (distance < min_distance) {
+            min_distance = distance;
+            closest = i;
+        }
+    }
+    return closest;
+}
+
+// The court rasterized into CELL_SIZE cells, built once on the host and
+// shared read-only by every world like the ShotModel. A cell stores the
+// zone bits or the closest inbound point that hold everywhere inside it,
+// or CELL_EXACT when a boundary crosses the cell and the query has to run
+// the exact test. The zone table alone is 18.8 KB, so it stays in cache.
+// A lone three point check is a single sqrt and stays on isThreePointSpot,
+// the grid pays off for the full zone and the closest inbound point.
+struct CourtZoneGrid {
+    static constexpr float CELL_SIZE = 0.5f;
+    static constexpr int32_t WIDTH = 188; // COURT_WIDTH / CELL_SIZE
+    static constexpr int32_t HEIGHT = 100; // COURT_HEIGHT / CELL_SIZE
+    static constexpr uint8_t CELL_EXACT = 0x80;
+
+    uint8_t zones[HEIGHT][WIDTH];
+    uint8_t inbound[HEIGHT][WIDTH];
+};
+
+// Host side construction, implemented in court_zones.cpp
+void buildCourtZoneGrid(CourtZoneGrid &grid);
+
+// Points off the court don't map to a cell and take the exact path
+inline bool courtZoneCell(float x, float y, int32_t &cx, int32_t &cy)
+{
+    if (isOutOfBounds(x, y)) {
+        return false;
+    }
+
+    constexpr float inv_cell = 1.f / CourtZoneGrid::CELL_SIZE;
+    cx = (int32_t)((x - MIN_X) * inv_cell);
+    cy = (int32_t)((y - MIN_Y) * inv_cell);
+    // Rounding can push a point just inside the far edge one cell over
+    cx = cx < CourtZoneGrid::WIDTH ? cx : CourtZoneGrid::WIDTH - 1;
+    cy = cy < CourtZoneGrid::HEIGHT ? cy : CourtZoneGrid::HEIGHT - 1;
+    return true;
+}
+
+inline uint32_t lookupCourtZone(const CourtZoneGrid &grid, float x, float y)
+{
+    int32_t cx, cy;
+    if (!courtZoneCell(x, y, cx, cy)) {
+        return exactCourtZone(x, y);
+    }
+
+    uint8_t cell = grid.zones[cy][cx];
+    if (cell & CourtZoneGrid::CELL_EXACT) {
+        return exactCourtZone(x, y);
+    }
+    return cell;
+}
+
+inline int32_t lookupClosestInbound(const CourtZoneGrid &grid,
+                                    float x, float y)
+{
+    int32_t cx, cy;
+    if (!courtZoneCell(x, y, cx, cy)) {
+        return exactClosestInbound(x, y);
+    }
+
+    uint8_t cell = grid.inbound[cy][cx];
+    if (cell & CourtZoneGrid::CELL_EXACT) {
+        return exactClosestInbound(x, y);
+    }
+    return cell;
+}
+
+}
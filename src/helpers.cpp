@@ -1,6 +1,8 @@
 #include "helpers.hpp"
+#include <madrona/sync.hpp>
 #include <cstdlib> 
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 #include <stdexcept>
 
@@ -39,9 +41,59 @@ float euclideanDistance(float x_1, float y_1, float x_2, float y_2) {
     return std::sqrt((x_2 - x_1) * (x_2 - x_1) + (y_2 - y_1) * (y_2 - y_1));
 }
 
-CourtPos updateCourtPositionStepped(const CourtPos &current_pos, const Action &action) {
+float calculateDistance(float x1, float y1, float x2, float y2) {
+    return euclideanDistance(x1, y1, x2, y2);
+}
+
+// One pass over every player pair, so the rule checks of a substep share
+// the distances instead of each player redoing its own sqrt against the
+// other three. Each pair is written to both halves of the matrices. The
+// rule checks only read distance, so the substep passes leave closingSpeed
+// and ballDistance alone and only the end of step pass pays for them.
+void fillPairwiseGeometry(const CourtPos *players, const BallState &ball,
+                          bool end_of_step, PairwiseGeometry &geometry) {
+    float x[ACTIVE_PLAYERS], y[ACTIVE_PLAYERS];
+    float vx[ACTIVE_PLAYERS], vy[ACTIVE_PLAYERS];
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        x[i] = players[i].x;
+        y[i] = players[i].y;
+        if (end_of_step) {
+            vx[i] = players[i].v * cosf(players[i].th);
+            vy[i] = players[i].v * sinf(players[i].th);
+        }
+    }
+
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        geometry.distance[i][i] = 0.f;
+        if (end_of_step) {
+            geometry.closingSpeed[i][i] = 0.f;
+            geometry.ballDistance[i] = calculateDistance(x[i], y[i],
+                                                         ball.x, ball.y);
+        }
+
+        for (int j = i + 1; j < ACTIVE_PLAYERS; j++) {
+            float dx = x[j] - x[i];
+            float dy = y[j] - y[i];
+            float dist = std::sqrt(dx * dx + dy * dy);
+            geometry.distance[i][j] = geometry.distance[j][i] = dist;
+            if (!end_of_step) {
+                continue;
+            }
+
+            // Rate the gap shrinks at, the relative velocity projected on
+            // the line between them. Stacked players have no direction.
+            float closing = 0.f;
+            if (dist > 0.f) {
+                closing = -(dx * (vx[j] - vx[i]) + dy * (vy[j] - vy[i])) / dist;
+            }
+            geometry.closingSpeed[i][j] = geometry.closingSpeed[j][i] = closing;
+        }
+    }
+}
+
+CourtPos updateCourtPositionStepped(const CourtPos &current_pos, const Action &action,
+                                   float stepdt) {
     CourtPos new_player_pos = current_pos;
-    float stepdt = D_T / COLLISION_CHECK_STEPS;
 
     float dx = action.vdes * cos(action.thdes);
     float dy = action.vdes * sin(action.thdes);
@@ -78,9 +130,9 @@ CourtPos updateCourtPositionStepped(const CourtPos &current_pos, const Action &a
     return new_player_pos;
 }
 
-CourtPos cancelPrevMovementStep(const CourtPos &current_pos, const Action &action) {
+CourtPos cancelPrevMovementStep(const CourtPos &current_pos, const Action &action,
+                               float stepdt) {
     CourtPos new_player_pos = current_pos;
-    float stepdt = D_T / COLLISION_CHECK_STEPS;
 
     new_player_pos.x -= new_player_pos.v * cos(new_player_pos.th) * stepdt;
     new_player_pos.y -= new_player_pos.v * sin(new_player_pos.th) * stepdt;
@@ -89,65 +141,96 @@ CourtPos cancelPrevMovementStep(const CourtPos &current_pos, const Action &actio
 }
 
 
-bool ballIsOOB(BallState &ball_state) {
-    if ((ball_state.x > MIN_X) && (ball_state.x < MAX_X) && 
-        (ball_state.y > MIN_Y) && (ball_state.y < MAX_Y)){
-        return false;
-    }
-
-    return true;
+bool ballIsOOB(const CourtZoneGrid &grid, BallState &ball_state) {
+    return (lookupCourtZone(grid, ball_state.x, ball_state.y) &
+            COURT_ZONE_OOB) != 0;
 }
 
-int findClosestInbound(BallState &ball_state){
-    int closest = 0; // Start with the first point as the closest
-    float minDistance = std::numeric_limits<float>::max();
-
-    for (int i = 0; i < INBOUND_POINTS.size(); i++) {
-        float distance = euclideanDistance(INBOUND_POINTS[i].x, INBOUND_POINTS[i].y, ball_state.x, ball_state.y);
-        if (distance < minDistance) {
-            minDistance = distance;
-            closest = i;
+// Call against self_id for a collision with opponent other_id while
+// ball_owner holds, passed or shot the ball. NO_CALL lets the move stand.
+FoulID collisionFoul(const CourtPos &self_pos, int32_t self_id,
+                     const CourtPos &other_pos, int32_t other_id,
+                     int32_t ball_owner)
+{
+    float v1_x = -1 * self_pos.v * cos(self_pos.th);
+    float v1_y = -1 * self_pos.v * sin(self_pos.th);
+    float v2_x = other_pos.v * cos(other_pos.th);
+    float v2_y = other_pos.v * sin(other_pos.th);
+
+    float impact_factor = sqrt(pow(v1_x + v2_x, 2) + pow(v1_y + v2_y, 2));
+
+    if ((other_pos.v < 0.5) && (self_pos.v < 0.5)){ // if both players arent really moving
+        // do nothing
+    } else if (((self_id / FIRST_TEAM2_PLAYER) == (ball_owner / FIRST_TEAM2_PLAYER))
+        && (self_id != ball_owner)){ // If we are off ball on offense
+        if ((impact_factor >= 1.0) && (self_pos.v >= 0.5)){ // and we run into them
+            return FoulID::CHARGE;
+        }
+    } else if (self_id == ball_owner){ // If we have the ball
+        if (other_pos.v < 0.5){ // and they are not moving
+            return FoulID::CHARGE;
+        }
+    } else if (other_id == ball_owner) { // If on defense, and player we collide with has the ball
+        if ((impact_factor >= 1.0) && (self_pos.v >= 0.5)){ // if we are moving
+            return FoulID::BLOCK;
+        }
+    } else if ((self_id / FIRST_TEAM2_PLAYER) != (ball_owner / FIRST_TEAM2_PLAYER)
+        && (other_id != ball_owner)){ // if on defense, player with we collide with doesnt have ball
+        if (other_pos.v < 0.5) { // if they are not moving
+            return FoulID::PUSH;
         }
     }
+    return FoulID::NO_CALL;
+}
 
-    return closest;
+// Grid lookup with the exact scan as fallback, see court_zones.hpp
+int findClosestInbound(const CourtZoneGrid &grid, BallState &ball_state){
+    return lookupClosestInbound(grid, ball_state.x, ball_state.y);
 }
 
+// A lone three point check is cheaper exact than through the grid
 bool isThreePointer(float x, float y, float hoopx){
-    return ((euclideanDistance(x, y, hoopx, LEFT_HOOP_Y) > 23.75) //23'9'' away from hoop
-        || (y > MAX_Y - 3)// top corner three
-        || (y < MIN_Y + 3));// bottom corner three
+    return isThreePointSpot(x, y, hoopx);
 }
 
-int32_t updateShotBallState(Engine &ctx, BallState &current_ball, const BallStatus &ball_status, const CourtPos &player_pos){
-    std::random_device rd;
-    std::mt19937 gen(rd());
+// shot_value is what takePlayerAction decided at release, returns it on a
+// make and 0 on a miss
+int32_t updateShotBallState(Engine &ctx, BallState &current_ball, const BallStatus &ball_status, 
+                            const CourtPos &player_pos, const StaticPlayerAttributes &attributes,
+                            int32_t shot_value){
+    WorldRNG &gen = ctx.data().rng;
     std::uniform_real_distribution<> dis(25.0, 45.0);
     current_ball.v = (float)dis(gen);
-    auto players = ctx.singleton<AgentList>().e;
 
     bool team2 = ball_status.heldBy >= FIRST_TEAM2_PLAYER;
 
     const float HOOP_X = (team2) ? RIGHT_HOOP_X : LEFT_HOOP_X;
     const float HOOP_Y = (team2) ? RIGHT_HOOP_Y : LEFT_HOOP_Y;
 
+    // Only the opposing team can contest, so skip straight to their slots.
+    // Measured from the final positions: PairwiseGeometry is filled before
+    // the later substeps' reverts and collision corrections, so its
+    // ballDistance can be a substep stale here.
+    auto players = ctx.singleton<AgentList>().e;
+    int first_defender = team2 ? 0 : FIRST_TEAM2_PLAYER;
     float min_dist = 12.0f;
-    for (int i = 0; i < ACTIVE_PLAYERS; i++){
-        if (i >= FIRST_TEAM2_PLAYER == team2){
-            continue;
-        }
-        Entity p = players[i];
-        float d = euclideanDistance(current_ball.x, current_ball.y, ctx.get<CourtPos>(p).x, ctx.get<CourtPos>(p).y);
-        if (d < min_dist){
-            min_dist = d;
-        }
+    for (int i = first_defender; i < first_defender + FIRST_TEAM2_PLAYER; i++){
+        const CourtPos &defender = ctx.get<CourtPos>(players[i]);
+        min_dist = std::min(min_dist, euclideanDistance(current_ball.x,
+            current_ball.y, defender.x, defender.y));
     }
 
-    float prob = probabilityOfShot(euclideanDistance(current_ball.x, current_ball.y, HOOP_X, HOOP_Y), 
+    // The player's 3PT% or FG% scales the make probability
+    bool three_pointer = shot_value == 3;
+
+    float prob = probabilityOfShot(*ctx.data().shotModel,
+                                euclideanDistance(current_ball.x, current_ball.y, HOOP_X, HOOP_Y), 
                                 HOOP_X,
                                 HOOP_Y,
                                 player_pos,
-                                min_dist
+                                min_dist,
+                                attributes,
+                                three_pointer
                             ); 
 
     // Generate a random chance for the decision
@@ -162,24 +245,20 @@ int32_t updateShotBallState(Engine &ctx, BallState &current_ball, const BallStat
 
     // Decide if the correct or perturbed angle should be assigned
     current_ball.th = base_th;
-    
-    current_ball.x += current_ball.v * cos(current_ball.th) * D_T;
-    current_ball.y += current_ball.v * sin(current_ball.th) * D_T;
+
+    // The ball leaves from the shooter, balltick sweeps it from here so a
+    // shot from next to the rim can't start past the hoop
 
     if (random_chance > prob){
         return 0;
     }
-    else if (isThreePointer(current_ball.x, current_ball.y, HOOP_X))
-    {
-        return 3;
-    }
-    
-    return 2;
+
+    return shot_value;
 }
 
 void changeBallToInPass(Engine &ctx, float th, float v, PlayerStatus &player_status, PlayerID &id) {
-    BallStatus* status = &ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall);
-    BallState* state = &ctx.get<BallState>(ctx.singleton<BallReference>().theBall);
+    BallStatus* status = &ctx.singleton<BallStatus>();
+    BallState* state = &ctx.singleton<BallState>();
     status->ballState = BallStatesPossibilities::BALL_IN_PASS;
     
     player_status.hasBall = false;
@@ -191,16 +270,16 @@ void changeBallToInPass(Engine &ctx, float th, float v, PlayerStatus &player_sta
 }
 
 bool isHoldingBall(PlayerID &id, Engine &ctx) {
-    return ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall).heldBy == id.id;
+    return ctx.singleton<BallStatus>().heldBy == id.id;
 } 
 
 bool isBallLoose(Engine &ctx) {
-    BallStatus* status = &ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall);
+    BallStatus* status = &ctx.singleton<BallStatus>();
     return status->heldBy == -1 && status->ballState == BallStatesPossibilities::BALL_IN_LOOSE;;
 }
 
 bool isBallInPass(Engine &ctx, PlayerID &id) {
-    BallStatus* status = &ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall);
+    BallStatus* status = &ctx.singleton<BallStatus>();
     return (id.id != status->whoPassed) && (status->heldBy == -1) && (status->ballState == BallStatesPossibilities::BALL_IN_PASS);
 }
 
@@ -208,6 +287,8 @@ bool canBallBeCaught(Engine &ctx, PlayerID &id) {
     return isBallInPass(ctx, id) || isBallLoose(ctx);
 }
 
+// Whether a player the ball has reached can catch it, evaluated at the
+// moment of contact. Range is the sweep's job, see balltick.
 bool shouldPlayerCatch(BallState *state, CourtPos &court_pos) {
     float ball_x = state->x;
     float ball_y = state->y;
@@ -215,12 +296,6 @@ bool shouldPlayerCatch(BallState *state, CourtPos &court_pos) {
     float player_x = court_pos.x;
     float player_y = court_pos.y;
 
-    // if within catching range 
-    if (!(std::abs(player_x - ball_x) < CATCHING_WINGSPAN 
-          && std::abs(player_y - ball_y) < CATCHING_WINGSPAN)) {
-        return false;
-    } 
-
     // calculate direction the pass is coming from
     float angle_of_pass = atan2(player_y - ball_y, player_x - ball_x);
 
@@ -231,106 +306,199 @@ bool shouldPlayerCatch(BallState *state, CourtPos &court_pos) {
         return false;
     }
 
-    float smaller_dt = D_T / 20;
-    // idea here is we want a small enough dt such that we are basically taking 
-    // a derivative. if we use dt normally we run the risk of the next_ball_pos 
-    // being further when both are in the same direction
-
-    float next_ball_pos_x = state->v * cos(state->th) * smaller_dt + ball_x;
-    float next_ball_pos_y = state->v * sin(state->th) * smaller_dt + ball_y;
-
-    float dist_curr = sqrt((ball_x - player_x) * (ball_x - player_x) +
-                           (ball_y - player_y) * (ball_y - player_y));
-    float next_distance = 
-        sqrt((next_ball_pos_x - player_x) * (next_ball_pos_x - player_x) +
-             (next_ball_pos_y - player_y) * (next_ball_pos_y - player_y));
     // We are doing these checks to make sure we aren't catching a ball that's 
-    // moving away from a player (in the opposite direction)
-    if (next_distance > dist_curr) {
+    // moving away from a player (in the opposite direction). The distance is
+    // shrinking exactly when the ball's velocity points towards the player.
+    float approach = cos(state->th) * (player_x - ball_x) +
+                     sin(state->th) * (player_y - ball_y);
+    if (state->v > 0 && approach < 0) {
         return false;
     }
 
     return true;
 }
 
-bool catchBallIfClose(Engine &ctx,
-                      CourtPos &court_pos,
-                      PlayerID &id, 
-                      PlayerStatus &status) {
-    BallState* state = &ctx.get<BallState>(ctx.singleton<BallReference>().theBall);
-    BallStatus* ball_status = &ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall);
+bool ballIsHeld(BallStatus &ball_held) {
+    return ball_held.heldBy != -1;
+}
+
+// Into [-pi, pi)
+float wrapAngle(float angle) {
+    angle = std::fmod(angle + (float)PI, (float)TWO_PI);
+    if (angle < 0) {
+        angle += (float)TWO_PI;
+    }
+    return angle - (float)PI;
+}
+
+// IEEE binary16 bits of value, rounded to nearest even. Written out by hand
+// so the CPU and GPU builds convert identically.
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs = bits & 0x7fffffff;
 
-    if (ball_status->ballState == BallStatesPossibilities::T1_NEED_TO_INBOUND){
-        if (id.id / FIRST_TEAM2_PLAYER != 0){
-            return false;
+    if (abs >= 0x7f800000) { // inf stays inf, nan stays (quiet) nan
+        return (uint16_t)(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0));
+    }
+    if (abs >= 0x47800000) { // 65536 and up overflow
+        return (uint16_t)(sign | 0x7c00);
+    }
+
+    if (abs < 0x38800000) { // below the smallest normal half
+        if (abs < 0x33000000) {
+            return (uint16_t)sign;
         }
-    } else if (ball_status->ballState == BallStatesPossibilities::T2_NEED_TO_INBOUND){
-        if (id.id / FIRST_TEAM2_PLAYER != 1){
-            return false;
+        uint32_t mant = (abs & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - (abs >> 23);
+        uint32_t half = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half & 1))) {
+            half++;
         }
+        return (uint16_t)(sign | half);
+    }
+
+    // Rebias the exponent, a carry out of the mantissa rounds up into it
+    uint32_t half = (abs >> 13) - ((127 - 15) << 10);
+    uint32_t rem = abs & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+        half++;
     }
+    return (uint16_t)(sign | half);
+}
 
+// round(value * scale) as int16 bits, saturated instead of wrapping
+uint16_t floatToFixed16(float value, float scale) {
+    float scaled = std::round(value * scale);
+    scaled = std::clamp(scaled, -32767.0f, 32767.0f);
+    return (uint16_t)(int16_t)scaled;
+}
 
-    if (shouldPlayerCatch(state, court_pos)) 
-    {
-        status.hasBall = true;
-        ball_status->heldBy = id.id;
-        ball_status->whoShot = -1;
-        ball_status->whoPassed = -1;
+// Direction to throw so a ball at pass_speed meets the receiver, assuming
+// they keep their current velocity. Solves |d + v t| = pass_speed * t for
+// the earliest t > 0, and falls back to throwing straight at them when the
+// receiver is running away faster than the pass.
+float leadPassAngle(const CourtPos &passer, const CourtPos &receiver, float pass_speed) {
+    float dx = receiver.x - passer.x;
+    float dy = receiver.y - passer.y;
+    float vx = receiver.v * cos(receiver.th);
+    float vy = receiver.v * sin(receiver.th);
+
+    float a = vx * vx + vy * vy - pass_speed * pass_speed;
+    float half_b = dx * vx + dy * vy;
+    float c = dx * dx + dy * dy;
+
+    float t = -1;
+    if (std::abs(a) < 1e-6f) {
+        if (half_b < 0) {
+            t = -c / (2 * half_b);
+        }
+    } else {
+        float disc = half_b * half_b - a * c;
+        if (disc >= 0) {
+            float root = std::sqrt(disc);
+            float t1 = (-half_b - root) / a;
+            float t2 = (-half_b + root) / a;
+            float lo = std::min(t1, t2);
+            float hi = std::max(t1, t2);
+            t = lo > 0 ? lo : hi;
+        }
+    }
 
-        state->v = 0;
-        state->th = 0;
-        
-        return true;
+    if (t <= 0) {
+        return atan2(dy, dx);
     }
-    return false;
+    return atan2(dy + vy * t, dx + vx * t);
 }
 
-bool ballIsHeld(BallStatus &ball_held) {
-    return ball_held.heldBy != -1;
+// Earliest fraction t in [0, 1] of the move from p to p + d (relative to the
+// circle's center) at which the point is within radius, or -1 if it never
+// gets there this tick. Starting inside counts as t = 0.
+float sweptCircleTOI(float px, float py, float dx, float dy, float radius) {
+    float c = px * px + py * py - radius * radius;
+    if (c <= 0) {
+        return 0;
+    }
+
+    float a = dx * dx + dy * dy;
+    float half_b = px * dx + py * dy;
+    if (a <= 0 || half_b >= 0) { // not moving, or moving away
+        return -1;
+    }
+
+    float disc = half_b * half_b - a * c;
+    if (disc < 0) {
+        return -1;
+    }
+
+    float t = (-half_b - std::sqrt(disc)) / a;
+    return t <= 1 ? t : -1;
 }
 
-// just doing with distance for right now
-float probabilityOfShot(float distance_from_basket, float hoop_x, float hoop_y, 
-                        const CourtPos &player_pos, float nearest_player_dist) 
-{
-    const float max_probability = 100.0f;  
-    const float min_probability = 0.0f;
+// Players of one world can emit in the same task, so slots are claimed atomically
+void emitGameEvent(Engine &ctx, GameEventType type, int32_t player_id, int32_t data) {
+    GameEventLog &log = ctx.singleton<GameEventLog>();
+    uint32_t idx = madrona::AtomicU32Ref(log.numEmitted).fetch_add_relaxed(1);
+
+    log.events[idx % EVENT_LOG_CAPACITY] = GameEvent {
+        type,
+        ctx.singleton<Scorecard>().ticksElapsed,
+        player_id,
+        data,
+    };
+}
 
-    float probability = max_probability * std::max(min_probability, std::min(1.0f, 1.0f - distance_from_basket / 50.0f));
-    
-    if (nearest_player_dist <= 12.0f) {
-        // Linear function to adjust probability
-        
-        float adjustment_factor = 0.2f + (0.8f * (nearest_player_dist / 12.0f));
-        probability *= adjustment_factor;
+// A pass picked up by the other team is a steal, anything else is a catch
+void emitPossessionEvent(Engine &ctx, int32_t catcher, int32_t passer) {
+    if (passer != -1 && (passer / FIRST_TEAM2_PLAYER) != (catcher / FIRST_TEAM2_PLAYER)) {
+        emitGameEvent(ctx, GameEventType::STEAL, catcher, passer);
+    } else {
+        emitGameEvent(ctx, GameEventType::CATCH, catcher, passer);
     }
-    
-    float v_adj = 0.25f * (player_pos.v / 30.0f);
-    probability *= 1.0f - v_adj;
+}
 
+// Table driven, see shot_model.hpp. The per player attributes scale the base
+// make probability relative to the league average for that shot type.
+float probabilityOfShot(const ShotModel &model, float distance_from_basket, float hoop_x, float hoop_y, 
+                        const CourtPos &player_pos, float nearest_player_dist,
+                        const StaticPlayerAttributes &attributes, bool three_pointer) 
+{
+    const float max_probability = 100.0f;  
+    const float min_probability = 0.0f;
 
-    float abx = -1.0f;
-    float aby = 0.0f;
+    // cos of the angle between the player's facing and the hoop direction
+    // used by the old model: alpha = pi - atan2(cby, cbx)
     float cbx = player_pos.x - hoop_x;
     float cby = player_pos.y - hoop_y;
-    float angba = atan2(aby, abx);
-    float angbc = atan2(cby, cbx);
-    float alpha = angba - angbc;
-
-    float deltaTheta = player_pos.facing - alpha;
-
-    while (deltaTheta > PI) {
-        deltaTheta -= 2.0f * PI;
+    float cb_len = std::sqrt(cbx * cbx + cby * cby);
+    float cos_delta = 1.0f;
+    if (cb_len > 0.0f) {
+        cos_delta = (-cosf(player_pos.facing) * cbx +
+                     sinf(player_pos.facing) * cby) / cb_len;
     }
-    while (deltaTheta < -PI) {
-        deltaTheta += 2.0f * PI;
+
+    float speed = player_pos.v;
+    if (attributes.runningSpeedMph > 0.0f) {
+        speed *= model.leagueRunningSpeedMph / attributes.runningSpeedMph;
     }
-    float facing_adj = abs(deltaTheta / PI);
 
-    probability *= 1.0f - abs(deltaTheta / PI);
+    float probability = lookupShotProbability(model, distance_from_basket,
+        nearest_player_dist, cos_delta, speed);
+
+    float player_pct = three_pointer ?
+        attributes.shootingPercentage3Points :
+        attributes.shootingPercentageFieldGoal;
+    float league_pct = three_pointer ?
+        model.leagueThreePointPct : model.leagueFieldGoalPct;
+    if (player_pct > 0.0f) {
+        probability *= player_pct / league_pct;
+    }
 
-    return std::min(max_probability, std::max(min_probability, probability)) * 1.0f;
+    return std::min(max_probability, std::max(min_probability, probability));
 }
 
 void makePlayerInboundBall(BallState &ball_state,
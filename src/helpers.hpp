@@ -11,19 +11,28 @@ namespace madsimple {
 
 // Function declarations
 CourtPos updateCourtPosition(const CourtPos &current_pos, const Action &action);
-CourtPos updateCourtPositionStepped(const CourtPos &current_pos, const Action &action);
-CourtPos cancelPrevMovementStep(const CourtPos &current_pos, const Action &action);
+CourtPos updateCourtPositionStepped(const CourtPos &current_pos, const Action &action,
+                                   float stepdt);
+CourtPos cancelPrevMovementStep(const CourtPos &current_pos, const Action &action,
+                               float stepdt);
+FoulID collisionFoul(const CourtPos &self_pos, int32_t self_id,
+                     const CourtPos &other_pos, int32_t other_id,
+                     int32_t ball_owner);
 
 BallState updateBallState(const BallState &current_ball, const BallStatesPossibilities &ball_held, 
                           const madrona::Entity *players, const Engine &ctx, float dt);
 
-bool ballIsOOB(BallState &ball_state);
-int findClosestInbound(BallState &ball_state);
+bool ballIsOOB(const CourtZoneGrid &grid, BallState &ball_state);
+int findClosestInbound(const CourtZoneGrid &grid, BallState &ball_state);
 
 bool isThreePointer(float x, float y, float hoopx);
-int32_t updateShotBallState(Engine &ctx, BallState &current_ball, const BallStatus &ball_status, const CourtPos &player_pos);
+int32_t updateShotBallState(Engine &ctx, BallState &current_ball, const BallStatus &ball_status, 
+                            const CourtPos &player_pos, const StaticPlayerAttributes &attributes,
+                            int32_t shot_value);
 
 float calculateDistance(float x1, float y1, float x2, float y2);
+void fillPairwiseGeometry(const CourtPos *players, const BallState &ball,
+                          bool end_of_step, PairwiseGeometry &geometry);
 
 float generateRandomValue(float min_val, float max_val);
 
@@ -38,19 +47,25 @@ bool shouldPlayerCatch(BallState *state, CourtPos &court_pos);
 
 bool ballIsHeld(BallStatus &ball_held);
 
+float sweptCircleTOI(float px, float py, float dx, float dy, float radius);
+
+float wrapAngle(float angle);
+uint16_t floatToHalf(float value);
+uint16_t floatToFixed16(float value, float scale);
+float leadPassAngle(const CourtPos &passer, const CourtPos &receiver, float pass_speed);
+
+void emitGameEvent(Engine &ctx, GameEventType type, int32_t player_id, int32_t data);
+void emitPossessionEvent(Engine &ctx, int32_t catcher, int32_t passer);
+
 void changeBallToInPass(Engine &ctx, 
                         float th, 
                         float v, 
                         PlayerStatus &player_status, 
                         PlayerID &id);
 
-bool catchBallIfClose(Engine &ctx,
-                      CourtPos &court_pos,
-                      PlayerID &id, 
-                      PlayerStatus &status);
-
-float probabilityOfShot(float distance_from_basket, float hoop_x, float hoop_y, 
-                        const CourtPos &player_pos, float nearest_player_dist);
+float probabilityOfShot(const ShotModel &model, float distance_from_basket, float hoop_x, float hoop_y, 
+                        const CourtPos &player_pos, float nearest_player_dist,
+                        const StaticPlayerAttributes &attributes, bool three_pointer);
 
 void makePlayerInboundBall(BallState &ball_state,
                            BallStatus &ball_status,
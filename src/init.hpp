@@ -3,6 +3,9 @@
 #include <madrona/sync.hpp>
 
 #include "court.hpp"
+#include "shot_model.hpp"
+#include "court_zones.hpp"
+#include "scenario_bank.hpp"
 
 namespace madsimple {
 
@@ -13,6 +16,11 @@ struct EpisodeManager {
 struct WorldInit {
     EpisodeManager *episodeMgr;
     const CourtState *court; // update initializer
+    const ShotModel *shotModel;
+    const CourtZoneGrid *courtZones;
+    const CourtRandomization *randomization;
+    const ScenarioBank *scenarioBank;
+    uint8_t *raster;
 };
 
 }
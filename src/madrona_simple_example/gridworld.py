@@ -3,16 +3,102 @@ import json
 import torch
 from ._madrona_simple_example_cpp import SimpleGridworldSimulator, madrona
 
-__all__ = ['GridWorld']
+__all__ = ['GridWorld', 'make_randomization']
 P_LOC_INDEX_TO_VAL = {0: "x", 1: "y", 2: "theta", 3: "velocity", 4:"angular v", 5: "facing angle"}
 B_LOC_INDEX_TO_VAL = {0: "x", 1: "y", 2: "theta", 3: "velocity"}
 
+# Matches ScenarioSampling in scenario_bank.hpp
+SCENARIO_SAMPLING = {"uniform": 0, "weighted": 1, "curriculum": 2}
+
+# Must match GameEventType in types.hpp and EVENT_LOG_CAPACITY in consts.hpp
+EVENT_TYPES = ["shot", "make", "miss", "pass", "catch", "steal", "foul"]
+EVENT_LOG_CAPACITY = 32
+
+# Must match MacroType and MacroStatus in types.hpp
+MACRO_TYPES = {"none": 0, "move_to": 1, "pass_to": 2, "shoot": 3, "shoot_when_open": 4}
+MACRO_STATUS = ["running", "done", "failed"]
+
+# Matches ObservationPrecision in court.hpp
+OBSERVATION_PRECISION = {"float32": 0, "float16": 1, "int16": 2}
+
+# Must match OBS_HISTORY_FRAMES in consts.hpp
+OBS_HISTORY_FRAMES = 4
+
+# Must match ACTIVE_PLAYERS in consts.hpp, the size of the pairwise geometry matrices
+ACTIVE_PLAYERS = 4
+
+# Bits of court_zones[..., 0], must match COURT_ZONE_* in court_zones.hpp. three_left / three_right are
+# for shots at the left (team 1) and right (team 2) hoop.
+COURT_ZONES = {"oob": 1, "three_left": 2, "three_right": 4, "corner": 8, "paint": 16}
+
+# Fixed point scales of the int16 state export, must match QUANT_* in consts.hpp
+QUANT_POSITION_SCALE = 512.0
+QUANT_ANGLE_SCALE = 8192.0
+QUANT_SPEED_SCALE = 512.0
+QUANT_ANGULAR_SCALE = 1024.0
+QUANT_PLAYER_SCALES = [QUANT_POSITION_SCALE, QUANT_POSITION_SCALE, QUANT_ANGLE_SCALE,
+                       QUANT_SPEED_SCALE, QUANT_ANGULAR_SCALE, QUANT_ANGLE_SCALE]
+QUANT_BALL_SCALES = [QUANT_POSITION_SCALE, QUANT_POSITION_SCALE, QUANT_ANGLE_SCALE, QUANT_SPEED_SCALE]
+QUANT_ACTION_SCALES = [QUANT_SPEED_SCALE, QUANT_ANGLE_SCALE, QUANT_ANGULAR_SCALE,
+                       QUANT_ANGLE_SCALE, QUANT_SPEED_SCALE]
+
+# Column order of PlayerBoxScore in types.hpp
+BOX_SCORE_STATS = ["points", "fga", "fgm", "3pa", "3pm", "passes", "passes_stolen", "steals", "fouls"]
+
+# League averages, must match DEFAULT_* in consts.hpp
+DEFAULT_ATTRIBUTES = {"three_point_pct": 36.0, "field_goal_pct": 47.0, "running_speed_mph": 20.45}
+
+def make_randomization(initial_player_pos,
+                       position_boxes = None, # per player ((xmin, xmax), (ymin, ymax))
+                       heading_range = None, # (min, max) for theta
+                       velocity_range = None, # (min, max) for velocity
+                       facing_range = None, # (min, max) for facing angle
+                       ball_holder_weights = None, # one weight per player, plus one for a loose ball
+                       attribute_ranges = None): # dict keyed like DEFAULT_ATTRIBUTES of (min, max)
+    """Packs a CourtRandomization (court.hpp) as the flat float array the simulator expects.
+    Anything left unset is pinned to the matching initial_player_pos value or default."""
+    players = []
+    for i, pos in enumerate(initial_player_pos):
+        x, y, th, v, _, facing = [float(p) for p in pos]
+        box = position_boxes[i] if position_boxes is not None else ((x, x), (y, y))
+        players += [*box[0], *box[1],
+                    *(heading_range or (th, th)),
+                    *(velocity_range or (v, v)),
+                    *(facing_range or (facing, facing))]
+
+    if ball_holder_weights is None:
+        ball_holder_weights = [0.0] * (len(initial_player_pos) + 1)
+        ball_holder_weights[2] = 1.0 # PLAYER_STARTING_WITH_BALL
+
+    attributes = []
+    for key, default in DEFAULT_ATTRIBUTES.items():
+        attributes += (attribute_ranges or {}).get(key, (default, default))
+
+    return np.array(players + list(ball_holder_weights) + attributes, dtype=np.float32)
+
 class GridWorld:
     def __init__(self,
                  initial_player_pos, # initial player positions
                  num_worlds,
                  gpu_sim = False,
                  gpu_id = 0,
+                 shot_model_path = None, # optional tuned shot tables, see save_default_shot_model
+                 randomization = None, # optional initial state distribution from make_randomization
+                 seed = 0,
+                 scenario_bank = None, # optional bank from scripts/compile_scenarios.py
+                 scenario_sampling = "uniform", # one of SCENARIO_SAMPLING
+                 curriculum_episodes_per_stage = 1000,
+                 raster_size = None, # (width, height) to render [num_worlds, 6, H, W] uint8 images
+                 shared_memory_name = None, # e.g. "/bball_sim", other processes attach with SharedSimulatorView
+                 shared_memory_actions = False, # take actions/choices from the shared memory writer
+                 deterministic = False, # bit-exact across thread counts, fills state_hash every step
+                 num_threads = 0, # CPU worker threads, 0 uses all of them
+                 adaptive_substeps = True, # False always runs the maximum movement/collision substeps
+                 observation_precision = "float32", # "float16" or "int16" also fills quantized_state, see split_quantized_state
+                 lazy_init = False, # bulk fill the initial state of all worlds, faster startup at high world counts
+                 initial_states = None, # optional [num_worlds, 4, 6] first episode player states, needs lazy_init without randomization or scenario_bank
+                 observation_history = False, # keep the last OBS_HISTORY_FRAMES observations in obs_history
+                 team_canonical = False, # gather_policies rows as team 1 sees the court, see gather_policies
             ):
         self.court_size = np.array([94.0, 50.0]) # added court size, however it is not passed into madrona yet, TBD on use
 
@@ -23,6 +109,25 @@ class GridWorld:
                 num_worlds = num_worlds, 
                 num_players = len(initial_player_pos), #give madrona number of players with initial positions
                 gpu_id = 0,
+                shot_model_path = shot_model_path or "",
+                randomization = randomization,
+                seed = seed,
+                scenario_bank_path = scenario_bank or "",
+                scenario_sampling = SCENARIO_SAMPLING[scenario_sampling],
+                curriculum_episodes_per_stage = curriculum_episodes_per_stage,
+                enable_raster = raster_size is not None,
+                raster_width = raster_size[0] if raster_size else 48,
+                raster_height = raster_size[1] if raster_size else 26,
+                shared_memory_name = shared_memory_name or "",
+                shared_memory_actions = shared_memory_actions,
+                deterministic = deterministic,
+                num_threads = num_threads,
+                adaptive_substeps = adaptive_substeps,
+                observation_precision = OBSERVATION_PRECISION[observation_precision],
+                lazy_init = lazy_init,
+                initial_states = None if initial_states is None else np.ascontiguousarray(initial_states, dtype=np.float32),
+                observation_history = observation_history,
+                team_canonical = team_canonical,
             )
 
         self.actions = self.sim.action_tensor().to_torch()
@@ -33,10 +138,168 @@ class GridWorld:
         self.foul_call = self.sim.foul_call_tensor().to_torch()
         self.scoreboard = self.sim.scorecard_tensor().to_torch()
         self.resettens = self.sim.reset_tensor().to_torch()
+        self.player_attributes = self.sim.player_attributes_tensor().to_torch() # 3PT%, FG%, running speed (mph)
+        self.scenarios = self.sim.scenario_tensor().to_torch() # [requested, active] scenario index per world
+        # Channels: team 1, team 2, ball, hoops, vx, vy (velocity is 128 + 127 * v / 30)
+        self.raster = self.sim.raster_tensor().to_torch() if raster_size else None
+        self.events = self.sim.event_tensor().to_torch() # see read_events
+        self.box_score = self.sim.box_score_tensor().to_torch() # [num_worlds, num_players, len(BOX_SCORE_STATS)]
+        self.state_hash = self.sim.state_hash_tensor().to_torch() # [num_worlds, 1], only updated when deterministic
+        self.substep_stats = self.sim.substep_stats_tensor().to_torch() # [num_worlds, 2] ticks, substeps run
+        self.active = self.sim.active_tensor().to_torch() # [num_worlds, 1], 0 freezes a world, see set_active
+        self.macro_command = self.sim.macro_command_tensor().to_torch() # [num_worlds, num_players, 3] type, target, status
+        self.macro_params = self.sim.macro_params_tensor().to_torch() # [num_worlds, num_players, 4] x, y, speed, open distance
+        self.observation_precision = observation_precision
+        # [num_worlds, 48] float16 or int16: players [4, 6], ball [4], actions [4, 5]
+        self.quantized_state = self.sim.quantized_state_tensor().to_torch() if observation_precision != "float32" else None
+        self.policy_ids = self.sim.policy_id_tensor().to_torch() # [num_worlds, 2] policy per team, negative for none
+        self.policy_batches = None
+        # [num_worlds, OBS_HISTORY_FRAMES, 36] newest first, rows laid out like the rollout observations.
+        # A reset world repeats its first state in every frame.
+        self.obs_history = self.sim.observation_history_tensor().to_torch() if observation_history else None
+        # Views of the per-world geometry the rule checks use, handy for reward shaping: player distances and
+        # closing speeds [num_worlds, 4, 4] (positive when a pair is approaching) and ball distances [num_worlds, 4]
+        pair_geometry = self.sim.pairwise_geometry_tensor().to_torch()
+        pairs = ACTIVE_PLAYERS * ACTIVE_PLAYERS
+        self.player_distances = pair_geometry[:, :pairs].view(-1, ACTIVE_PLAYERS, ACTIVE_PLAYERS)
+        self.closing_speeds = pair_geometry[:, pairs:2 * pairs].view(-1, ACTIVE_PLAYERS, ACTIVE_PLAYERS)
+        self.ball_distances = pair_geometry[:, 2 * pairs:]
+        # [num_worlds, num_players, 2] COURT_ZONES bits and closest inbound point index, after the latest step
+        self.court_zones = self.sim.court_zone_tensor().to_torch()
 
     def step(self):
         self.sim.step()
 
+    def read_events(self, world, cursor = 0):
+        # Returns the events emitted since cursor as dicts, plus the new cursor.
+        # Events older than EVENT_LOG_CAPACITY behind the newest are lost.
+        log = self.events[world]
+        num_emitted = int(log[-1])
+        first = max(cursor, num_emitted - EVENT_LOG_CAPACITY)
+        events = []
+        for n in range(first, num_emitted):
+            event_type, tick, player, data = log[(n % EVENT_LOG_CAPACITY) * 4:(n % EVENT_LOG_CAPACITY) * 4 + 4].tolist()
+            events.append({"type": EVENT_TYPES[event_type], "tick": tick, "player": player, "data": data})
+        return events, num_emitted
+
+    def read_box_score(self, reset = False):
+        # Per player counters summed over all worlds, keyed by BOX_SCORE_STATS
+        totals = self.sim.box_score_totals(reset).to_torch().clone()
+        return {stat: totals[:, i] for i, stat in enumerate(BOX_SCORE_STATS)}
+
+    def split_quantized_state(self, quantized = None, dequantize = False):
+        # Views of quantized_state (or a stored copy of it) as players [..., 4, 6],
+        # ball [..., 4] and actions [..., 4, 5]. dequantize returns float32
+        # values, undoing the int16 scales; float16 is just upcast.
+        q = self.quantized_state if quantized is None else quantized
+        num_players = self.player_pos.shape[1]
+        players = q[..., :num_players * 6].unflatten(-1, (num_players, 6))
+        ball = q[..., num_players * 6:num_players * 6 + 4]
+        actions = q[..., num_players * 6 + 4:].unflatten(-1, (num_players, 5))
+        if not dequantize:
+            return players, ball, actions
+        if q.dtype == torch.float16:
+            return players.float(), ball.float(), actions.float()
+
+        def scale(t, scales):
+            return t.float() / torch.tensor(scales, device=t.device)
+        return scale(players, QUANT_PLAYER_SCALES), scale(ball, QUANT_BALL_SCALES), scale(actions, QUANT_ACTION_SCALES)
+
+    def start_rollout(self, horizon):
+        # Records the next horizon steps into preallocated [T, num_worlds, ...]
+        # CPU tensors, returned as a dict. Per step: write values[t] and the
+        # actions, step(), then write rewards[t]. When done, write the bootstrap
+        # values[T] and call compute_advantages.
+        self.sim.start_rollout(horizon)
+        self.rollout = {
+            "observations": self.sim.rollout_observations().to_torch(), # [T, W, 36], see ROLLOUT_OBS_DIM
+            "actions": self.sim.rollout_actions().to_torch(), # [T, W, P, 5]
+            "choices": self.sim.rollout_choices().to_torch(), # [T, W, P]
+            "rewards": self.sim.rollout_rewards().to_torch(), # [T, W, P]
+            "dones": self.sim.rollout_dones().to_torch(), # [T, W], world was reset by that step
+            "active": self.sim.rollout_active().to_torch(), # [T, W], 0 where the world was frozen and nothing happened
+            "values": self.sim.rollout_values().to_torch(), # [T + 1, W, P]
+            "advantages": self.sim.rollout_advantages().to_torch(), # [T, W, P]
+            "returns": self.sim.rollout_returns().to_torch(), # [T, W, P]
+        }
+        return self.rollout
+
+    def compute_advantages(self, gamma = 0.99, lam = 0.95):
+        # GAE(lambda) over the steps collected so far, fills rollout advantages and returns
+        self.sim.compute_advantages(gamma, lam)
+        return self.rollout["advantages"], self.rollout["returns"]
+
+    def gather_policies(self, num_policies):
+        # Packs the observation of every (world, team) by policy_ids. Returns one
+        # dict per policy with observations [n, 36], actions [n, 2, 5], choices [n, 2]
+        # and slots [n] (world * 2 + team). actions and choices hold the current
+        # values; overwrite them and call scatter_policies to apply every policy.
+        # With team_canonical, team 2 rows are turned 180 degrees about center court
+        # (x, y negated, headings + pi) with its own players first, so every row
+        # attacks the left hoop and one policy can serve both teams. Their thdes and
+        # pass_th are turned back when scattered.
+        self.sim.gather_policy_batches(num_policies)
+        if self.policy_batches is None:
+            self.policy_batches = {
+                "observations": self.sim.policy_observations().to_torch(),
+                "actions": self.sim.policy_actions().to_torch(),
+                "choices": self.sim.policy_choices().to_torch(),
+                "slots": self.sim.policy_slots().to_torch(),
+            }
+        offsets = self.sim.policy_offsets().to_torch().tolist()
+        return [{k: v[offsets[p]:offsets[p + 1]] for k, v in self.policy_batches.items()}
+                for p in range(num_policies)]
+
+    def scatter_policies(self):
+        # Writes the per policy actions and choices from gather_policies back to the simulator
+        self.sim.scatter_policy_batches()
+
+    def memory_report(self):
+        # Approximate simulator bytes per world by component, plus the totals
+        report = dict(self.sim.memory_report())
+        per_world = sum(report.values())
+        report["total_per_world"] = per_world
+        report["total"] = per_world * self.active.shape[0]
+        return report
+
+    def average_substeps(self):
+        # Movement/collision substeps actually run per world per tick so far
+        totals = self.substep_stats.sum(dim=0, dtype=torch.int64)
+        return totals[1].item() / max(totals[0].item(), 1)
+
+    def command(self, macro, worlds, players, x = 0.0, y = 0.0, speed = 0.0, target = -1, open_distance = 0.0):
+        # Issues a macro action (see MACRO_TYPES) to players of worlds, which can be
+        # indices or index tensors of the same shape. The C++ controller drives the
+        # player every tick until macro_command[..., 2] reports done or failed.
+        #   move_to: run to (x, y) at speed
+        #   pass_to: lead pass to player target at speed (0 for the default)
+        #   shoot: shoot now
+        #   shoot_when_open: go to (x, y) at speed, shoot once no defender is within open_distance
+        # "none" hands the player back to the raw actions/choices tensors.
+        self.macro_params[worlds, players, 0] = x
+        self.macro_params[worlds, players, 1] = y
+        self.macro_params[worlds, players, 2] = speed
+        self.macro_params[worlds, players, 3] = open_distance
+        self.macro_command[worlds, players, 0] = MACRO_TYPES[macro]
+        self.macro_command[worlds, players, 1] = target
+        self.macro_command[worlds, players, 2] = 0
+
+    def set_active(self, worlds = None):
+        # Only the given worlds advance on the next steps, the rest stay
+        # frozen (pending resets included) until they are activated again
+        if worlds is None:
+            self.active[:] = 1
+        else:
+            self.active[:] = 0
+            self.active[worlds] = 1
+
+    def request_reset(self, worlds = None):
+        # Flagged worlds start a new episode at the end of the next step
+        if worlds is None:
+            self.resettens[:] = 1
+        else:
+            self.resettens[worlds] = 1
+
     def reset(self, input_path):
         try:
             with open(input_path, 'r') as file:
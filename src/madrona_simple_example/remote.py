@@ -0,0 +1,88 @@
+import socket
+import struct
+import numpy as np
+from .shared import SharedSimulatorView
+
+__all__ = ['RemoteGridWorld']
+
+# Must match server_protocol.hpp
+SERVER_PROTOCOL_MAGIC = 0x53565342
+SERVER_PROTOCOL_VERSION = 1
+MSG_HELLO, MSG_WELCOME, MSG_STEP, MSG_STEP_RESULT, MSG_ERROR = 1, 2, 3, 4, 5
+
+HEADER = struct.Struct("<IIQ") # magic, type, payload bytes
+HELLO = struct.Struct("<IIII") # version, first world, num worlds, reserved
+WELCOME = struct.Struct("<IIII64s") # version, server worlds, players, reserved, shm name
+STEP_RESULT = struct.Struct("<Q") # tick, then rewards [n, 2] f4 and dones [n] u1
+
+class RemoteGridWorld:
+    """Drives worlds [first_world, first_world + num_worlds) of a bball_server
+    (src/server.cpp) without building a simulator in this process. The state
+    attributes (player_pos, ball_pos, who_holds, scoreboard, foul_call, events,
+    box_score, ...) and the inputs (actions, choices, active) are numpy views of
+    those worlds in the server's shared memory, shaped like GridWorld's. Write
+    the inputs, call step(), then read the new state: the server doesn't step
+    again until every client has sent its next step."""
+
+    def __init__(self, first_world, num_worlds, socket_path = "/tmp/bball_sim.sock"):
+        self.first_world = first_world
+        self.num_worlds = num_worlds
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(socket_path)
+
+        self._send(MSG_HELLO, HELLO.pack(SERVER_PROTOCOL_VERSION, first_world, num_worlds, 0))
+        _, self.server_worlds, self.num_players, _, shm_name = WELCOME.unpack(self._expect(MSG_WELCOME))
+
+        self.shared = SharedSimulatorView(shm_name.split(b"\0")[0].decode())
+        worlds = slice(first_world, first_world + num_worlds)
+        for name, buffer in self.shared.buffers.items():
+            setattr(self, name, buffer[worlds])
+        self.tick = 0
+
+    def step(self, resets = None):
+        # resets: optional [num_worlds] flags, those worlds start a new episode
+        # at the end of this step. Returns rewards [num_worlds, 2] (team 1, team 2
+        # point differential of the step) and dones [num_worlds], set where the
+        # world was reset by the client or the server's episode length.
+        n = self.num_worlds
+        flags = np.zeros(n, dtype=np.uint8) if resets is None else \
+            np.asarray(resets).reshape(n).astype(np.uint8)
+        self._send(MSG_STEP, flags.tobytes())
+
+        payload = self._expect(MSG_STEP_RESULT)
+        (self.tick,) = STEP_RESULT.unpack_from(payload)
+        rewards = np.frombuffer(payload, dtype=np.float32, count=n * 2,
+                                offset=STEP_RESULT.size).reshape(n, 2)
+        dones = np.frombuffer(payload, dtype=np.uint8, count=n,
+                              offset=STEP_RESULT.size + n * 8).astype(bool)
+        return rewards, dones
+
+    def close(self):
+        for name in list(self.shared.buffers.keys()):
+            delattr(self, name)
+        self.shared.close()
+        self.sock.close()
+
+    def _send(self, msg_type, payload):
+        self.sock.sendall(HEADER.pack(SERVER_PROTOCOL_MAGIC, msg_type, len(payload)) + payload)
+
+    def _recv_exact(self, num_bytes):
+        data = bytearray(num_bytes)
+        view = memoryview(data)
+        while len(view) > 0:
+            n = self.sock.recv_into(view)
+            if n == 0:
+                raise ConnectionError("bball_server closed the connection")
+            view = view[n:]
+        return bytes(data)
+
+    def _expect(self, msg_type):
+        magic, got, num_bytes = HEADER.unpack(self._recv_exact(HEADER.size))
+        payload = self._recv_exact(num_bytes)
+        if magic != SERVER_PROTOCOL_MAGIC:
+            raise RuntimeError("Not a bball_server on the other end of the socket")
+        if got == MSG_ERROR:
+            raise RuntimeError(f"bball_server: {payload.decode(errors='replace')}")
+        if got != msg_type:
+            raise RuntimeError(f"Expected message {msg_type} from bball_server, got {got}")
+        return payload
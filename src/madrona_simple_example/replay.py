@@ -0,0 +1,70 @@
+import torch
+from ._madrona_simple_example_cpp import ReplayBuffer as _NativeReplayBuffer
+
+__all__ = ['ReplayBuffer']
+
+def _rows(t, dtype, width):
+    # [N, width] contiguous CPU tensor, accepts a single transition too
+    t = torch.as_tensor(t).detach().to(device="cpu", dtype=dtype)
+    return t.reshape(-1, width).contiguous()
+
+class ReplayBuffer:
+    """Columnar transition store backed by the native ReplayBuffer in
+    replay_buffer.hpp. push() takes one transition like the old list based
+    buffers in sac.py / hybrid_sac.py, add() takes one row per world.
+    sample() returns tensors aliasing buffers that the next sample()
+    overwrites, clone them (or .to('cuda')) if they must outlive it."""
+
+    def __init__(self, capacity, state_dim, cont_action_dim, disc_action_dim = 0,
+                 max_batch_size = 256, prioritized = False, alpha = 0.6, beta = 0.4,
+                 epsilon = 1e-6, seed = 0):
+        self.state_dim = state_dim
+        self.cont_action_dim = cont_action_dim
+        self.disc_action_dim = disc_action_dim
+        self.prioritized = prioritized
+        self.beta = beta
+        self.last_indices = None
+        self.last_weights = None
+        self.buffer = _NativeReplayBuffer(capacity, state_dim, cont_action_dim, disc_action_dim,
+                                          max_batch_size, prioritized, alpha, epsilon, seed)
+
+    def add(self, state, cont_action, disc_action, reward, next_state, done):
+        self.buffer.add(_rows(state, torch.float32, self.state_dim),
+                        _rows(cont_action, torch.float32, self.cont_action_dim),
+                        _rows(disc_action, torch.int32, self.disc_action_dim) if self.disc_action_dim > 0 else None,
+                        _rows(reward, torch.float32, 1).view(-1),
+                        _rows(next_state, torch.float32, self.state_dim),
+                        _rows(done, torch.float32, 1).view(-1))
+
+    def push(self, state, *transition):
+        # (state, action, reward, next_state, done) for continuous agents,
+        # (state, cont_action, disc_action, reward, next_state, done) otherwise
+        if self.disc_action_dim > 0:
+            cont_action, disc_action, reward, next_state, done = transition
+        else:
+            cont_action, reward, next_state, done = transition
+            disc_action = None
+        self.add(state, cont_action, disc_action, [float(reward)], next_state, [float(done)])
+
+    def sample(self, batch_size, beta = None):
+        # Same tuple layout as push, disc_action as int64 [batch]. With
+        # prioritized sampling the importance weights and the indices to pass
+        # back to update_priorities are kept in last_weights / last_indices.
+        batch = self.buffer.sample(batch_size, self.beta if beta is None else beta)
+        state, cont_action, disc_action, reward, next_state, done, indices, weights = \
+            (t.to_torch() for t in batch)
+        self.last_indices = indices
+        self.last_weights = weights
+        if self.disc_action_dim > 0:
+            disc = disc_action[:, 0].long() if self.disc_action_dim == 1 else disc_action.long()
+            return state, cont_action, disc, reward, next_state, done
+        return state, cont_action, reward, next_state, done
+
+    def update_priorities(self, priorities, indices = None):
+        # e.g. |td_error| of the last sampled batch
+        indices = self.last_indices if indices is None else indices
+        self.buffer.update_priorities(torch.as_tensor(indices, dtype=torch.int64).contiguous(),
+                                      torch.as_tensor(priorities).detach().float().cpu().contiguous())
+
+    def __len__(self):
+        return len(self.buffer)
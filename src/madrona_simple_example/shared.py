@@ -0,0 +1,89 @@
+import time
+import numpy as np
+from multiprocessing import shared_memory, resource_tracker
+from ._madrona_simple_example_cpp import atomic_load_acquire_u64, atomic_store_release_u64
+
+__all__ = ['SharedSimulatorView']
+
+# Must match SharedExportHeader / SharedBufferDesc in shm_export.hpp
+SHARED_EXPORT_MAGIC = 0x4d485342
+SHARED_EXPORT_VERSION = 2
+MAX_BUFFERS = 16
+
+BUFFER_DESC_DTYPE = np.dtype([
+    ("name", "S32"), ("dtype", "S4"), ("num_dims", "<u4"),
+    ("dims", "<i8", (4,)), ("offset", "<u8"), ("num_bytes", "<u8"),
+])
+
+HEADER_DTYPE = np.dtype([
+    ("magic", "<u4"), ("version", "<u4"),
+    ("sequence", "<u8"), ("action_sequence", "<u8"), ("consumed_action_sequence", "<u8"),
+    ("num_worlds", "<u4"), ("num_buffers", "<u4"), ("owner_pid", "<u4"), ("reserved", "<u4"),
+    ("buffers", BUFFER_DESC_DTYPE, (MAX_BUFFERS,)),
+])
+
+class SharedSimulatorView:
+    """Attaches to a simulator started with shared_memory_name set.
+    buffers holds zero-copy numpy views that may be mid-update, snapshot()
+    returns a consistent copy using the simulator's seqlock."""
+
+    def __init__(self, name):
+        self.shm = shared_memory.SharedMemory(name=name.lstrip("/"))
+        # The simulator owns the object, don't let this process unlink it on exit
+        resource_tracker.unregister(self.shm._name, "shared_memory")
+
+        self.header = np.ndarray((), dtype=HEADER_DTYPE, buffer=self.shm.buf)
+        if (self.header["magic"] != SHARED_EXPORT_MAGIC or
+                self.header["version"] != SHARED_EXPORT_VERSION):
+            raise RuntimeError(f"{name} is not a simulator shared memory export")
+
+        self.num_worlds = int(self.header["num_worlds"])
+        self.buffers = {}
+        for desc in self.header["buffers"][:int(self.header["num_buffers"])]:
+            shape = tuple(int(d) for d in desc["dims"][:int(desc["num_dims"])])
+            self.buffers[desc["name"].decode()] = np.ndarray(
+                shape, dtype=np.dtype(desc["dtype"].decode()),
+                buffer=self.shm.buf, offset=int(desc["offset"]))
+
+    @property
+    def sequence(self):
+        return int(self.header["sequence"])
+
+    def snapshot(self, names = None):
+        names = names or self.buffers.keys()
+        while True:
+            start = self.sequence
+            if start % 2 == 1:
+                time.sleep(0)
+                continue
+            copies = {name: self.buffers[name].copy() for name in names}
+            if self.sequence == start:
+                return start, copies
+
+    def _counter_address(self, field):
+        return self.header.ctypes.data + HEADER_DTYPE.fields[field][1]
+
+    def write_actions(self, actions = None, choices = None, timeout = None):
+        # Only valid when the simulator was started with shared_memory_actions.
+        # Waits (up to timeout seconds) for the simulator to pull the previous
+        # actions before overwriting them, then publishes the new ones with a
+        # release store so the simulator never copies a half-written batch.
+        action_seq = self._counter_address("action_sequence")
+        consumed_seq = self._counter_address("consumed_action_sequence")
+        pending = atomic_load_acquire_u64(action_seq)
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while atomic_load_acquire_u64(consumed_seq) != pending:
+            if deadline is not None and time.monotonic() > deadline:
+                raise TimeoutError("simulator hasn't pulled the previous actions")
+            time.sleep(0)
+
+        if actions is not None:
+            self.buffers["actions"][...] = actions
+        if choices is not None:
+            self.buffers["choices"][...] = choices
+        atomic_store_release_u64(action_seq, pending + 1)
+
+    def close(self):
+        self.header = None
+        self.buffers = {}
+        self.shm.close()
@@ -1,5 +1,7 @@
 #include "mgr.hpp"
 #include "sim.hpp"
+#include "shm_export.hpp"
+#include "helpers.hpp"
 
 #include <madrona/utils.hpp>
 #include <madrona/importer.hpp>
@@ -11,30 +13,111 @@
 #endif
 
 #include <charconv>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 using namespace madrona;
 using namespace madrona::py;
 
 namespace madsimple {
 
+// Splits [0, count) into one contiguous range per host thread. Small
+// counts aren't worth the thread startup, and since threads are started
+// per call this is only for one time setup, never the step path.
+template <typename Fn>
+static void parallelFor(uint64_t count, uint32_t num_threads, Fn &&fn)
+{
+    if (num_threads == 0) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    if (num_threads == 1 || count < 4096) {
+        fn(0, count);
+        return;
+    }
+
+    uint64_t chunk = (count + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (uint64_t begin = 0; begin < count; begin += chunk) {
+        uint64_t end = std::min(count, begin + chunk);
+        threads.emplace_back([&fn, begin, end]() { fn(begin, end); });
+    }
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+// Host side rollout storage, every buffer is [T, numWorlds, ...] except
+// values which has the bootstrap row at T
+struct RolloutStorage {
+    uint32_t horizon = 0;
+    uint32_t cursor = 0;
+    std::vector<float> observations; // [T, W, ROLLOUT_OBS_DIM]
+    std::vector<float> actions; // [T, W, P, 5]
+    std::vector<int32_t> choices; // [T, W, P]
+    std::vector<float> rewards; // [T, W, P], filled by the learner
+    std::vector<float> dones; // [T, W]
+    std::vector<float> active; // [T, W], 0 where the world was frozen
+    std::vector<float> values; // [T + 1, W, P], filled by the learner
+    std::vector<float> advantages; // [T, W, P]
+    std::vector<float> returns; // [T, W, P]
+    std::vector<float> nextValues; // [W, P] computeAdvantages scratch
+    std::vector<float> running; // [W, P] computeAdvantages scratch
+};
+
+// Rows of every (world, team) sorted by the policy driving it, see
+// Manager::gatherPolicyBatches
+struct PolicyBatches {
+    std::vector<int64_t> offsets; // [numPolicies + 1]
+    std::vector<int32_t> teamPolicies; // [W * 2] copy of the export
+    std::vector<int32_t> slots; // [W * 2] world * 2 + team
+    std::vector<float> observations; // [W * 2, ROLLOUT_OBS_DIM]
+    std::vector<float> actions; // [W * 2, 2, 5]
+    std::vector<int32_t> choices; // [W * 2, 2]
+    std::vector<float> worldObservations; // [W, ROLLOUT_OBS_DIM] staging
+    std::vector<float> courtActions; // [W * 2, 2, 5] teamCanonical staging
+};
+
 struct Manager::Impl {
     Config cfg;
     EpisodeManager *episodeMgr;
 
     // Added courtData structure, which contains number of players, and array of players and their locations
     CourtState *courtData;
+    ShotModel *shotModel;
+    CourtZoneGrid *courtZones;
+    CourtRandomization *randomization;
+    ScenarioBank *scenarioBank;
+    uint8_t *rasterData;
+    std::unique_ptr<SharedExport> sharedExport;
+    int64_t boxScoreTotals[ACTIVE_PLAYERS * NUM_BOX_SCORE_STATS];
+    RolloutStorage rollout;
+    PolicyBatches policyBatches;
 
     // Added court_state ot constructor, which gives input to courtData
     inline Impl(const Config &c,
                 EpisodeManager *ep_mgr,
-                CourtState *court_state)
+                CourtState *court_state,
+                ShotModel *shot_model,
+                CourtZoneGrid *court_zones,
+                CourtRandomization *court_randomization,
+                ScenarioBank *scenario_bank,
+                uint8_t *raster_data)
         : cfg(c),
           episodeMgr(ep_mgr),
-          courtData(court_state)
+          courtData(court_state),
+          shotModel(shot_model),
+          courtZones(court_zones),
+          randomization(court_randomization),
+          scenarioBank(scenario_bank),
+          rasterData(raster_data)
     {}
 
     inline virtual ~Impl() {}
@@ -42,6 +125,86 @@ struct Manager::Impl {
     virtual void run() = 0;
     virtual Tensor exportTensor(ExportID slot, TensorElementType type,
                                 Span<const int64_t> dims) = 0;
+    virtual void * exportPtr(ExportID slot) = 0;
+    // Host readable copy of an exported buffer, valid until the next call
+    virtual const void * hostExport(ExportID slot, uint64_t num_bytes) = 0;
+    virtual void zeroExport(ExportID slot, uint64_t num_bytes) = 0;
+    virtual void uploadExport(ExportID slot, const void *src,
+                              uint64_t num_bytes) = 0;
+
+    inline void setupSharedExport();
+    inline void writeObservations(float *obs);
+    inline void recordRolloutStep();
+    inline void bulkInitialize(const CourtState &court);
+    inline PolicyBatches & allocPolicyBatches();
+
+    // Writes fn(i) to element i of an exported buffer from every host
+    // thread, straight into the export on the CPU backend and through a
+    // host staging copy on the GPU
+    template <typename T, typename Fn>
+    inline void fillExport(ExportID slot, uint64_t count, Fn &&fn)
+    {
+        std::vector<T> staging;
+        T *dst;
+        if (cfg.execMode == ExecMode::CPU) {
+            dst = (T *)exportPtr(slot);
+        } else {
+            staging.resize(count);
+            dst = staging.data();
+        }
+
+        parallelFor(count, cfg.numThreads, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; i++) {
+                dst[i] = fn(i);
+            }
+        });
+
+        if (!staging.empty()) {
+            uploadExport(slot, staging.data(), sizeof(T) * count);
+        }
+    }
+
+    // Copies row_elems values of each gathered policy row over that
+    // (world, team)'s values in an exported per-player buffer
+    template <typename T>
+    inline void scatterTeamRows(ExportID slot, const T *rows,
+                                uint64_t row_elems)
+    {
+        uint64_t num_rows = policyBatches.offsets.back();
+        uint64_t num_bytes = sizeof(T) * cfg.numWorlds * 2 * row_elems;
+        const int32_t *slots = policyBatches.slots.data();
+
+        std::vector<T> staging;
+        T *dst;
+        if (cfg.execMode == ExecMode::CPU) {
+            dst = (T *)exportPtr(slot);
+        } else {
+            // Teams without a policy keep their current values
+            staging.resize(num_bytes / sizeof(T));
+            memcpy(staging.data(), hostExport(slot, num_bytes), num_bytes);
+            dst = staging.data();
+        }
+
+        // Memory bound, threads wouldn't buy anything here
+        for (uint64_t row = 0; row < num_rows; row++) {
+            memcpy(dst + (uint64_t)slots[row] * row_elems,
+                   rows + row * row_elems, sizeof(T) * row_elems);
+        }
+
+        if (!staging.empty()) {
+            uploadExport(slot, staging.data(), num_bytes);
+        }
+    }
+
+    // Wraps a buffer the manager allocated itself rather than an ECS export
+    inline Tensor managerTensor(void *ptr, TensorElementType type,
+                                Span<const int64_t> dims) const
+    {
+        if (cfg.execMode == ExecMode::CUDA) {
+            return Tensor(ptr, type, dims, cfg.gpuID);
+        }
+        return Tensor(ptr, type, dims, Optional<int>::none());
+    }
 
     // Add CourtState to constructor
     static inline Impl * init(const Config &cfg, const CourtState &src_players);
@@ -49,6 +212,7 @@ struct Manager::Impl {
 
 struct Manager::CPUImpl final : Manager::Impl {
     using ExecT = TaskGraphExecutor<Engine, Sim, Sim::Config, WorldInit>;
+    MappedScenarioBank *mappedScenarios;
     ExecT cpuExec;
 
     // Add courtData to constructor
@@ -56,11 +220,21 @@ struct Manager::CPUImpl final : Manager::Impl {
                    const Sim::Config &sim_cfg,
                    EpisodeManager *episode_mgr,
                    CourtState *court_data,
+                   ShotModel *shot_model,
+                   CourtZoneGrid *court_zones,
+                   CourtRandomization *court_randomization,
+                   MappedScenarioBank *mapped_scenarios,
+                   uint8_t *raster_data,
                    WorldInit *world_inits)
-        : Impl(mgr_cfg, episode_mgr, court_data),
+        : Impl(mgr_cfg, episode_mgr, court_data, shot_model, court_zones,
+               court_randomization,
+               mapped_scenarios ? &mapped_scenarios->bank : nullptr,
+               raster_data),
+          mappedScenarios(mapped_scenarios),
           cpuExec({
                   .numWorlds = mgr_cfg.numWorlds,
                   .numExportedBuffers = (uint32_t)ExportID::NumExports,
+                  .numWorkers = mgr_cfg.numThreads,
               }, sim_cfg, world_inits, 1)
     {}
 
@@ -68,6 +242,14 @@ struct Manager::CPUImpl final : Manager::Impl {
     inline virtual ~CPUImpl() final {
         delete episodeMgr;
         free(courtData);
+        delete shotModel;
+        delete courtZones;
+        delete randomization;
+        if (mappedScenarios != nullptr) {
+            unmapScenarioBank(*mappedScenarios);
+            delete mappedScenarios;
+        }
+        free(rasterData);
     }
 
     inline virtual void run() final { cpuExec.run(); }
@@ -79,6 +261,27 @@ struct Manager::CPUImpl final : Manager::Impl {
         void *dev_ptr = cpuExec.getExported((uint32_t)slot);
         return Tensor(dev_ptr, type, dims, Optional<int>::none());
     }
+
+    inline virtual void * exportPtr(ExportID slot) final
+    {
+        return cpuExec.getExported((uint32_t)slot);
+    }
+
+    inline virtual const void * hostExport(ExportID slot, uint64_t) final
+    {
+        return cpuExec.getExported((uint32_t)slot);
+    }
+
+    inline virtual void zeroExport(ExportID slot, uint64_t num_bytes) final
+    {
+        memset(cpuExec.getExported((uint32_t)slot), 0, num_bytes);
+    }
+
+    inline virtual void uploadExport(ExportID slot, const void *src,
+                                     uint64_t num_bytes) final
+    {
+        memcpy(cpuExec.getExported((uint32_t)slot), src, num_bytes);
+    }
 };
 
 // Updated this GPU support, however unsure if this runs on CUDA yet
@@ -86,14 +289,21 @@ struct Manager::CPUImpl final : Manager::Impl {
 struct Manager::GPUImpl final : Manager::Impl {
     MWCudaExecutor gpuExec;
     MWCudaLaunchGraph stepGraph;
+    std::vector<char> hostStaging;
 
     inline GPUImpl(CUcontext cu_ctx,
                    const Manager::Config &mgr_cfg,
                    const Sim::Config &sim_cfg,
                    EpisodeManager *episode_mgr,
                    CourtState *court_data,
+                   ShotModel *shot_model,
+                   CourtZoneGrid *court_zones,
+                   CourtRandomization *court_randomization,
+                   ScenarioBank *scenario_bank,
+                   uint8_t *raster_data,
                    WorldInit *world_inits)
-        : Impl(mgr_cfg, episode_mgr, court_data),
+        : Impl(mgr_cfg, episode_mgr, court_data, shot_model, court_zones,
+               court_randomization, scenario_bank, raster_data),
           gpuExec({
                   .worldInitPtr = world_inits,
                   .numWorldInitBytes = sizeof(WorldInit),
@@ -116,6 +326,17 @@ struct Manager::GPUImpl final : Manager::Impl {
     inline virtual ~GPUImpl() final {
         REQ_CUDA(cudaFree(episodeMgr));
         REQ_CUDA(cudaFree(courtData));
+        REQ_CUDA(cudaFree(shotModel));
+        REQ_CUDA(cudaFree(courtZones));
+        if (randomization != nullptr) {
+            REQ_CUDA(cudaFree(randomization));
+        }
+        if (scenarioBank != nullptr) {
+            REQ_CUDA(cudaFree(scenarioBank));
+        }
+        if (rasterData != nullptr) {
+            REQ_CUDA(cudaFree(rasterData));
+        }
     }
 
     inline virtual void run() final { gpuExec.run(stepGraph); }
@@ -126,26 +347,129 @@ struct Manager::GPUImpl final : Manager::Impl {
         void *dev_ptr = gpuExec.getExported((uint32_t)slot);
         return Tensor(dev_ptr, type, dims, cfg.gpuID);
     }
+
+    virtual inline void * exportPtr(ExportID slot) final
+    {
+        return gpuExec.getExported((uint32_t)slot);
+    }
+
+    virtual inline const void * hostExport(ExportID slot,
+                                           uint64_t num_bytes) final
+    {
+        hostStaging.resize(num_bytes);
+        REQ_CUDA(cudaMemcpy(hostStaging.data(),
+            gpuExec.getExported((uint32_t)slot), num_bytes,
+            cudaMemcpyDeviceToHost));
+        return hostStaging.data();
+    }
+
+    virtual inline void zeroExport(ExportID slot, uint64_t num_bytes) final
+    {
+        REQ_CUDA(cudaMemset(gpuExec.getExported((uint32_t)slot), 0,
+                            num_bytes));
+    }
+
+    virtual inline void uploadExport(ExportID slot, const void *src,
+                                     uint64_t num_bytes) final
+    {
+        REQ_CUDA(cudaMemcpy(gpuExec.getExported((uint32_t)slot), src,
+                            num_bytes, cudaMemcpyHostToDevice));
+    }
 };
 #endif
 
 // Added CourtState to world initialization
 static HeapArray<WorldInit> setupWorldInitData(int64_t num_worlds,
                                                EpisodeManager *episode_mgr,
-                                               const CourtState *court)
+                                               const CourtState *court,
+                                               const ShotModel *shot_model,
+                                               const CourtZoneGrid *court_zones,
+                                               const CourtRandomization *randomization,
+                                               const ScenarioBank *scenario_bank,
+                                               uint8_t *raster_data,
+                                               uint64_t raster_bytes_per_world,
+                                               uint32_t num_threads)
 {
     HeapArray<WorldInit> world_inits(num_worlds);
 
-    for (int64_t i = 0; i < num_worlds; i++) {
-        world_inits[i] = WorldInit {
-            episode_mgr,
-            court,
-        };
-    }
+    parallelFor(num_worlds, num_threads, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; i++) {
+            world_inits[i] = WorldInit {
+                episode_mgr,
+                court,
+                shot_model,
+                court_zones,
+                randomization,
+                scenario_bank,
+                raster_data ? raster_data + i * raster_bytes_per_world :
+                    nullptr,
+            };
+        }
+    });
 
     return world_inits;
 }
 
+static inline bool usesLazyInit(const Manager::Config &cfg)
+{
+    return cfg.lazyInit && cfg.randomization == nullptr &&
+        (cfg.scenarioBankPath == nullptr || cfg.scenarioBankPath[0] == '\0');
+}
+
+// Shot tables are built on the host, either from the defaults or a tuning file
+static ShotModel * setupShotModel(const Manager::Config &cfg)
+{
+    ShotModel *shot_model = new ShotModel;
+    if (cfg.shotModelPath == nullptr || cfg.shotModelPath[0] == '\0') {
+        buildDefaultShotModel(*shot_model);
+    } else if (!loadShotModel(cfg.shotModelPath, *shot_model)) {
+        FATAL("Failed to load shot model from %s", cfg.shotModelPath);
+    }
+
+    return shot_model;
+}
+
+static CourtZoneGrid * setupCourtZones()
+{
+    CourtZoneGrid *court_zones = new CourtZoneGrid;
+    buildCourtZoneGrid(*court_zones);
+    return court_zones;
+}
+
+// Worlds get the holder weights as running sums, like the scenario bank's
+static CourtRandomization accumulateRandomization(
+    const CourtRandomization &spec)
+{
+    CourtRandomization randomization = spec;
+    float total = 0.f;
+    for (int i = 0; i < ACTIVE_PLAYERS + 1; i++) {
+        total += spec.ballHolderWeights[i];
+        randomization.ballHolderWeights[i] = total;
+    }
+
+    return randomization;
+}
+
+static MappedScenarioBank * setupScenarioBank(const Manager::Config &cfg)
+{
+    if (cfg.scenarioBankPath == nullptr || cfg.scenarioBankPath[0] == '\0') {
+        return nullptr;
+    }
+
+    MappedScenarioBank *mapped = new MappedScenarioBank;
+    if (!mapScenarioBank(cfg.scenarioBankPath, cfg.scenarioSampling,
+                         cfg.curriculumEpisodesPerStage, *mapped)) {
+        FATAL("Failed to load scenario bank from %s", cfg.scenarioBankPath);
+    }
+
+    return mapped;
+}
+
+static inline uint64_t rasterBytesPerWorld(const Manager::Config &cfg)
+{
+    return (uint64_t)RASTER_NUM_CHANNELS * cfg.rasterWidth * cfg.rasterHeight;
+}
+
 // Added CourtState to this
 Manager::Impl * Manager::Impl::init(const Config &cfg,
                                     const CourtState &src_court)
@@ -154,6 +478,16 @@ Manager::Impl * Manager::Impl::init(const Config &cfg,
     Sim::Config sim_cfg {
         .maxEpisodeLength = cfg.maxEpisodeLength,
         .enableViewer = false,
+        .seed = cfg.seed,
+        .enableRaster = cfg.enableRaster,
+        .rasterWidth = cfg.rasterWidth,
+        .rasterHeight = cfg.rasterHeight,
+        .deterministic = cfg.deterministic,
+        .numWorlds = cfg.numWorlds,
+        .adaptiveSubsteps = cfg.adaptiveSubsteps,
+        .observationPrecision = cfg.observationPrecision,
+        .lazyInit = usesLazyInit(cfg),
+        .observationHistory = cfg.observationHistory,
     };
 
     switch (cfg.execMode) {
@@ -179,10 +513,31 @@ Manager::Impl * Manager::Impl::init(const Config &cfg,
 
         memcpy(cpu_player_data, src_court.players, player_bytes);
 
+        ShotModel *shot_model = setupShotModel(cfg);
+        CourtZoneGrid *court_zones = setupCourtZones();
+
+        CourtRandomization *randomization = nullptr;
+        if (cfg.randomization != nullptr) {
+            randomization = new CourtRandomization(
+                accumulateRandomization(*cfg.randomization));
+        }
+
+        MappedScenarioBank *mapped_scenarios = setupScenarioBank(cfg);
+
+        uint8_t *raster_data = nullptr;
+        if (cfg.enableRaster) {
+            raster_data = (uint8_t *)calloc(cfg.numWorlds,
+                                            rasterBytesPerWorld(cfg));
+        }
+
         HeapArray<WorldInit> world_inits = setupWorldInitData(cfg.numWorlds,
-            episode_mgr, cpu_court);
+            episode_mgr, cpu_court, shot_model, court_zones, randomization,
+            mapped_scenarios ? &mapped_scenarios->bank : nullptr,
+            raster_data, rasterBytesPerWorld(cfg), cfg.numThreads);
 
-        return new CPUImpl(cfg, sim_cfg, episode_mgr, cpu_court, world_inits.data());
+        return new CPUImpl(cfg, sim_cfg, episode_mgr, cpu_court, shot_model,
+                           court_zones, randomization, mapped_scenarios,
+                           raster_data, world_inits.data());
     } break;
     case ExecMode::CUDA: {
         // I have not implemented in the CUDA for this section yet
@@ -212,10 +567,78 @@ Manager::Impl * Manager::Impl::init(const Config &cfg,
         };
 
 
+        ShotModel *host_shot_model = setupShotModel(cfg);
+        ShotModel *gpu_shot_model =
+            (ShotModel *)cu::allocGPU(sizeof(ShotModel));
+        REQ_CUDA(cudaMemcpy(gpu_shot_model, host_shot_model, sizeof(ShotModel),
+                            cudaMemcpyHostToDevice));
+        delete host_shot_model;
+
+        CourtZoneGrid *host_court_zones = setupCourtZones();
+        CourtZoneGrid *gpu_court_zones =
+            (CourtZoneGrid *)cu::allocGPU(sizeof(CourtZoneGrid));
+        REQ_CUDA(cudaMemcpy(gpu_court_zones, host_court_zones,
+                            sizeof(CourtZoneGrid), cudaMemcpyHostToDevice));
+        delete host_court_zones;
+
+        CourtRandomization *gpu_randomization = nullptr;
+        if (cfg.randomization != nullptr) {
+            CourtRandomization host_randomization =
+                accumulateRandomization(*cfg.randomization);
+            gpu_randomization = (CourtRandomization *)cu::allocGPU(
+                sizeof(CourtRandomization));
+            REQ_CUDA(cudaMemcpy(gpu_randomization, &host_randomization,
+                                sizeof(CourtRandomization),
+                                cudaMemcpyHostToDevice));
+        }
+
+        // The bank, its scenarios and weights go up as one allocation
+        ScenarioBank *gpu_scenario_bank = nullptr;
+        MappedScenarioBank *mapped_scenarios = setupScenarioBank(cfg);
+        if (mapped_scenarios != nullptr) {
+            const ScenarioBank &host_bank = mapped_scenarios->bank;
+            uint64_t scenario_bytes =
+                sizeof(Scenario) * host_bank.numScenarios;
+            uint64_t weight_bytes = sizeof(float) * host_bank.numScenarios;
+
+            char *gpu_bank_data = (char *)cu::allocGPU(
+                sizeof(ScenarioBank) + scenario_bytes + weight_bytes);
+            auto *gpu_scenarios =
+                (Scenario *)(gpu_bank_data + sizeof(ScenarioBank));
+            auto *gpu_weights =
+                (float *)((char *)gpu_scenarios + scenario_bytes);
+
+            ScenarioBank staged_bank = host_bank;
+            staged_bank.scenarios = gpu_scenarios;
+            staged_bank.cumulativeWeights = gpu_weights;
+
+            REQ_CUDA(cudaMemcpy(gpu_bank_data, &staged_bank,
+                sizeof(ScenarioBank), cudaMemcpyHostToDevice));
+            REQ_CUDA(cudaMemcpy(gpu_scenarios, host_bank.scenarios,
+                scenario_bytes, cudaMemcpyHostToDevice));
+            REQ_CUDA(cudaMemcpy(gpu_weights, host_bank.cumulativeWeights,
+                weight_bytes, cudaMemcpyHostToDevice));
+
+            unmapScenarioBank(*mapped_scenarios);
+            delete mapped_scenarios;
+            gpu_scenario_bank = (ScenarioBank *)gpu_bank_data;
+        }
+
+        uint8_t *gpu_raster_data = nullptr;
+        if (cfg.enableRaster) {
+            uint64_t raster_bytes = cfg.numWorlds * rasterBytesPerWorld(cfg);
+            gpu_raster_data = (uint8_t *)cu::allocGPU(raster_bytes);
+            REQ_CUDA(cudaMemset(gpu_raster_data, 0, raster_bytes));
+        }
+
         HeapArray<WorldInit> world_inits = setupWorldInitData(cfg.numWorlds,
-            episode_mgr, cpu_court);
+            episode_mgr, cpu_court, gpu_shot_model, gpu_court_zones,
+            gpu_randomization, gpu_scenario_bank, gpu_raster_data, rasterBytesPerWorld(cfg),
+            cfg.numThreads);
 
         return new GPUImpl(cu_ctx, cfg, sim_cfg, episode_mgr, cpu_court,
+                           gpu_shot_model, gpu_court_zones, gpu_randomization,
+                           gpu_scenario_bank, gpu_raster_data,
                            world_inits.data());
 #endif
     } break;
@@ -223,17 +646,279 @@ Manager::Impl * Manager::Impl::init(const Config &cfg,
     }
 }
 
+// Exported buffers mirrored into shared memory, dims match the tensor getters
+void Manager::Impl::setupSharedExport()
+{
+    if (cfg.execMode != ExecMode::CPU) {
+        FATAL("Shared memory export is only supported on the CPU backend");
+    }
+
+    int64_t num_worlds = cfg.numWorlds;
+    int64_t num_players = cfg.numPlayers;
+
+    auto buffer = [&](const char *name, const char *dtype, ExportID slot,
+                      uint64_t elem_bytes, std::initializer_list<int64_t> dims,
+                      bool writable) {
+        SharedExport::Buffer buf {};
+        buf.name = name;
+        buf.dtype = dtype;
+        buf.simPtr = exportPtr(slot);
+        buf.numDims = (uint32_t)dims.size();
+        buf.numBytes = elem_bytes;
+        uint32_t i = 0;
+        for (int64_t dim : dims) {
+            buf.dims[i++] = dim;
+            buf.numBytes *= dim;
+        }
+        buf.writable = writable;
+        return buf;
+    };
+
+    bool ext_actions = cfg.sharedMemoryActions;
+    SharedExport::Buffer buffers[] = {
+        buffer("player_pos", "<f4", ExportID::CourtPos, 4,
+               {num_worlds, num_players, 6}, false),
+        buffer("actions", "<f4", ExportID::Action, 4,
+               {num_worlds, num_players, 5}, ext_actions),
+        buffer("choices", "<i4", ExportID::Choice, 4,
+               {num_worlds, num_players, 1}, ext_actions),
+        buffer("ball_pos", "<f4", ExportID::BallLoc, 4,
+               {num_worlds, 4}, false),
+        buffer("who_holds", "<i4", ExportID::WhoHolds, 4,
+               {num_worlds, 4}, false),
+        buffer("scoreboard", "<i4", ExportID::Scorecard, 4,
+               {num_worlds, 4}, false),
+        buffer("foul_call", "<i4", ExportID::CalledFoul, 4,
+               {num_worlds, num_players, 1}, false),
+        buffer("player_attributes", "<f4", ExportID::StaticPlayerAttributes, 4,
+               {num_worlds, num_players, 3}, false),
+        buffer("scenarios", "<i4", ExportID::ScenarioSelection, 4,
+               {num_worlds, 2}, false),
+        buffer("events", "<i4", ExportID::Events, 4,
+               {num_worlds, EVENT_LOG_CAPACITY * 4 + 1}, false),
+        buffer("box_score", "<i4", ExportID::BoxScore, 4,
+               {num_worlds, num_players, NUM_BOX_SCORE_STATS}, false),
+        buffer("active", "<i4", ExportID::WorldActive, 4,
+               {num_worlds, 1}, ext_actions),
+    };
+
+    sharedExport.reset(SharedExport::create(cfg.sharedMemoryName,
+        cfg.numWorlds, buffers, sizeof(buffers) / sizeof(buffers[0])));
+    if (!sharedExport) {
+        FATAL("Failed to create shared memory export %s, is another "
+              "simulator using the name?", cfg.sharedMemoryName);
+    }
+
+    sharedExport->publish();
+}
+
 // Added initial conditions to manager
 Manager::Manager(const Config &cfg,
                  const CourtState &src_court)
     : impl_(Impl::init(cfg, src_court))
-{}
+{
+    if (usesLazyInit(cfg)) {
+        impl_->bulkInitialize(src_court);
+    }
+    // Only valid for the duration of the constructor
+    impl_->cfg.initialPlayerStates = nullptr;
+
+    if (cfg.sharedMemoryName != nullptr && cfg.sharedMemoryName[0] != '\0') {
+        impl_->setupSharedExport();
+    }
+}
 
 Manager::~Manager() {}
 
+// Same state initializeWorldState gives a world starting from the
+// CourtState (or the caller's rows), written column by column for every
+// world at once
+void Manager::Impl::bulkInitialize(const CourtState &court)
+{
+    uint64_t num_worlds = cfg.numWorlds;
+    uint64_t num_agents = num_worlds * ACTIVE_PLAYERS;
+    const float *initial = cfg.initialPlayerStates;
+
+    auto initialPos = [&](uint64_t agent) {
+        if (initial != nullptr) {
+            const float *src = initial + agent * 6;
+            return CourtPos { src[0], src[1], src[2], src[3], src[4], src[5] };
+        }
+        const Player &src = court.players[agent % ACTIVE_PLAYERS];
+        return CourtPos { src.x, src.y, src.th, src.v, src.om, src.facing };
+    };
+
+    fillExport<CourtPos>(ExportID::CourtPos, num_agents, initialPos);
+    fillExport<Action>(ExportID::Action, num_agents, [](uint64_t) {
+        return Action { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    });
+    fillExport<PlayerDecision>(ExportID::Choice, num_agents, [](uint64_t) {
+        return PlayerDecision::MOVE;
+    });
+    fillExport<FoulID>(ExportID::CalledFoul, num_agents, [](uint64_t) {
+        return FoulID::NO_CALL;
+    });
+    fillExport<StaticPlayerAttributes>(ExportID::StaticPlayerAttributes,
+                                       num_agents, [](uint64_t) {
+        return StaticPlayerAttributes {
+            DEFAULT_THREE_POINT_PCT, DEFAULT_FIELD_GOAL_PCT,
+            DEFAULT_RUNNING_SPEED_MPH,
+        };
+    });
+    fillExport<MacroCommand>(ExportID::MacroCommand, num_agents, [](uint64_t) {
+        return MacroCommand { MacroType::NONE, -1, MacroStatus::RUNNING };
+    });
+    fillExport<MacroParams>(ExportID::MacroParams, num_agents, [](uint64_t) {
+        return MacroParams {};
+    });
+    // The exact tests give what the grid would, without needing the grid
+    // on the host in GPU mode
+    fillExport<CourtZone>(ExportID::CourtZone, num_agents, [&](uint64_t agent) {
+        CourtPos pos = initialPos(agent);
+        return CourtZone {
+            exactCourtZone(pos.x, pos.y), exactClosestInbound(pos.x, pos.y),
+        };
+    });
+
+    // Sim's lazy constructor marks the same player as holding the ball
+    constexpr int32_t holder = PLAYER_STARTING_WITH_BALL;
+    auto initialBall = [&](uint64_t w) {
+        CourtPos pos = initialPos(w * ACTIVE_PLAYERS + holder);
+        return BallState { pos.x, pos.y, pos.th, pos.v };
+    };
+    fillExport<BallState>(ExportID::BallLoc, num_worlds, initialBall);
+    fillExport<PairwiseGeometry>(ExportID::PairwiseGeometry, num_worlds,
+                                 [&](uint64_t w) {
+        CourtPos players[ACTIVE_PLAYERS];
+        for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+            players[i] = initialPos(w * ACTIVE_PLAYERS + i);
+        }
+        PairwiseGeometry geometry;
+        fillPairwiseGeometry(players, initialBall(w), true, geometry);
+        return geometry;
+    });
+    fillExport<BallStatus>(ExportID::WhoHolds, num_worlds, [](uint64_t) {
+        return BallStatus {
+            holder, NOT_PREVIOUSLY_SHOT, -1,
+            BallStatesPossibilities::BALL_IS_HELD,
+        };
+    });
+    fillExport<Scorecard>(ExportID::Scorecard, num_worlds, [](uint64_t) {
+        return Scorecard { 0, 0, 1, 0 };
+    });
+
+    if (cfg.observationHistory) {
+        std::vector<float> obs(num_worlds * ROLLOUT_OBS_DIM);
+        writeObservations(obs.data());
+        fillExport<ObservationHistory>(ExportID::ObservationHistory,
+                                       num_worlds, [&](uint64_t w) {
+            ObservationHistory history;
+            for (int i = 0; i < OBS_HISTORY_FRAMES; i++) {
+                memcpy(history.frames[i], obs.data() + w * ROLLOUT_OBS_DIM,
+                       sizeof(history.frames[i]));
+            }
+            return history;
+        });
+    }
+}
+
+// One ROLLOUT_OBS_DIM row per world from the current exports. On the GPU
+// every hostExport is a device to host copy into the same staging buffer,
+// so each one is consumed before the next.
+void Manager::Impl::writeObservations(float *obs)
+{
+    uint64_t num_worlds = cfg.numWorlds;
+
+    auto *pos = (const CourtPos *)hostExport(ExportID::CourtPos,
+        sizeof(CourtPos) * ACTIVE_PLAYERS * num_worlds);
+    for (uint64_t w = 0; w < num_worlds; w++) {
+        memcpy(obs + w * ROLLOUT_OBS_DIM, pos + w * ACTIVE_PLAYERS,
+               sizeof(CourtPos) * ACTIVE_PLAYERS);
+    }
+
+    constexpr int ball_offset = ACTIVE_PLAYERS * 6;
+    auto *ball = (const BallState *)hostExport(ExportID::BallLoc,
+        sizeof(BallState) * num_worlds);
+    for (uint64_t w = 0; w < num_worlds; w++) {
+        memcpy(obs + w * ROLLOUT_OBS_DIM + ball_offset, &ball[w],
+               sizeof(BallState));
+    }
+
+    auto copyInts = [&](ExportID slot, int offset) {
+        auto *src = (const int32_t *)hostExport(slot,
+            sizeof(int32_t) * 4 * num_worlds);
+        for (uint64_t w = 0; w < num_worlds; w++) {
+            float *dst = obs + w * ROLLOUT_OBS_DIM + offset;
+            for (int i = 0; i < 4; i++) {
+                dst[i] = (float)src[w * 4 + i];
+            }
+        }
+    };
+    copyInts(ExportID::WhoHolds, ball_offset + 4);
+    copyInts(ExportID::Scorecard, ball_offset + 8);
+}
+
+// Copies the state the coming step starts from and the inputs it runs with
+// into slot cursor of the rollout
+void Manager::Impl::recordRolloutStep()
+{
+    uint64_t num_worlds = cfg.numWorlds;
+    uint64_t t = rollout.cursor;
+    writeObservations(rollout.observations.data() +
+                      t * num_worlds * ROLLOUT_OBS_DIM);
+
+    uint64_t num_agents = num_worlds * ACTIVE_PLAYERS;
+    memcpy(rollout.actions.data() + t * num_agents * 5,
+           hostExport(ExportID::Action, sizeof(Action) * num_agents),
+           sizeof(Action) * num_agents);
+    memcpy(rollout.choices.data() + t * num_agents,
+           hostExport(ExportID::Choice, sizeof(int32_t) * num_agents),
+           sizeof(int32_t) * num_agents);
+
+    // Frozen worlds don't run this step, so neither their transition nor a
+    // pending reset happens
+    auto *active = (const WorldActive *)hostExport(ExportID::WorldActive,
+        sizeof(WorldActive) * num_worlds);
+    float *step_active = rollout.active.data() + t * num_worlds;
+    for (uint64_t w = 0; w < num_worlds; w++) {
+        step_active[w] = active[w].active != 0 ? 1.f : 0.f;
+    }
+
+    // Active worlds flagged for reset end their episode with this step
+    auto *resets = (const WorldReset *)hostExport(ExportID::Reset,
+        sizeof(WorldReset) * num_worlds);
+    float *dones = rollout.dones.data() + t * num_worlds;
+    for (uint64_t w = 0; w < num_worlds; w++) {
+        dones[w] = resets[w].reset != 0 ? step_active[w] : 0.f;
+    }
+
+    rollout.cursor += 1;
+}
+
 void Manager::step()
 {
+    if (impl_->sharedExport) {
+        impl_->sharedExport->pullActions();
+    }
+
+    if (impl_->rollout.cursor < impl_->rollout.horizon) {
+        impl_->recordRolloutStep();
+    }
+
     impl_->run();
+
+    if (impl_->sharedExport) {
+        impl_->sharedExport->publish();
+    }
+}
+
+void Manager::saveDefaultShotModel(const char *path)
+{
+    ShotModel shot_model;
+    buildDefaultShotModel(shot_model);
+    if (!saveShotModel(path, shot_model)) {
+        FATAL("Failed to write shot model to %s", path);
+    }
 }
 
 // Added new tensor playerTensor, that theoretically will hold [numWorlds, numPlayers, location] (unsure about this implementation)
@@ -293,6 +978,568 @@ Tensor Manager::resetTensor() const
                                    1,
                                });
 }
+
+Tensor Manager::scenarioTensor() const
+{
+    return impl_->exportTensor(ExportID::ScenarioSelection,
+                               TensorElementType::Int32,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   2,
+                               });
+}
+
+Tensor Manager::rasterTensor() const
+{
+    if (impl_->rasterData == nullptr) {
+        FATAL("Raster observations were not enabled in Manager::Config");
+    }
+
+    return impl_->managerTensor(impl_->rasterData, TensorElementType::UInt8,
+        {impl_->cfg.numWorlds, RASTER_NUM_CHANNELS,
+         impl_->cfg.rasterHeight, impl_->cfg.rasterWidth});
+}
+
+// Flattened GameEventLog: EVENT_LOG_CAPACITY x (type, tick, player, data),
+// then the running event count
+Tensor Manager::eventTensor() const
+{
+    return impl_->exportTensor(ExportID::Events, TensorElementType::Int32,
+        {impl_->cfg.numWorlds, EVENT_LOG_CAPACITY * 4 + 1});
+}
+
+Tensor Manager::boxScoreTensor() const
+{
+    return impl_->exportTensor(ExportID::BoxScore, TensorElementType::Int32,
+        {impl_->cfg.numWorlds, impl_->cfg.numPlayers, NUM_BOX_SCORE_STATS});
+}
+
+Tensor Manager::boxScoreTotals(bool reset)
+{
+    uint64_t num_bytes = sizeof(BoxScore) * impl_->cfg.numWorlds;
+    auto *scores = (const int32_t *)impl_->hostExport(ExportID::BoxScore,
+                                                      num_bytes);
+
+    constexpr int num_counters = ACTIVE_PLAYERS * NUM_BOX_SCORE_STATS;
+    int64_t *totals = impl_->boxScoreTotals;
+    for (int i = 0; i < num_counters; i++) {
+        totals[i] = 0;
+    }
+
+    // Each world is a flat block of counters, so this is a straight column sum
+    for (uint32_t w = 0; w < impl_->cfg.numWorlds; w++) {
+        const int32_t *world_scores = scores + (uint64_t)w * num_counters;
+        for (int i = 0; i < num_counters; i++) {
+            totals[i] += world_scores[i];
+        }
+    }
+
+    if (reset) {
+        impl_->zeroExport(ExportID::BoxScore, num_bytes);
+    }
+
+    return Tensor(totals, TensorElementType::Int64,
+        {ACTIVE_PLAYERS, NUM_BOX_SCORE_STATS}, Optional<int>::none());
+}
+
+Tensor Manager::stateHashTensor() const
+{
+    return impl_->exportTensor(ExportID::StateHash, TensorElementType::Int64,
+                               {impl_->cfg.numWorlds, 1});
+}
+
+Tensor Manager::substepStatsTensor() const
+{
+    return impl_->exportTensor(ExportID::SubstepStats, TensorElementType::Int32,
+                               {impl_->cfg.numWorlds, 2});
+}
+
+Tensor Manager::activeTensor() const
+{
+    return impl_->exportTensor(ExportID::WorldActive, TensorElementType::Int32,
+                               {impl_->cfg.numWorlds, 1});
+}
+
+Tensor Manager::macroCommandTensor() const
+{
+    return impl_->exportTensor(ExportID::MacroCommand, TensorElementType::Int32,
+                               {impl_->cfg.numWorlds, impl_->cfg.numPlayers, 3});
 }
 
+Tensor Manager::macroParamsTensor() const
+{
+    return impl_->exportTensor(ExportID::MacroParams, TensorElementType::Float32,
+                               {impl_->cfg.numWorlds, impl_->cfg.numPlayers, 4});
+}
+
+Tensor Manager::quantizedStateTensor() const
+{
+    if (impl_->cfg.observationPrecision == ObservationPrecision::Float32) {
+        FATAL("Reduced precision export was not enabled in Manager::Config");
+    }
+
+    TensorElementType type =
+        impl_->cfg.observationPrecision == ObservationPrecision::Float16 ?
+            TensorElementType::Float16 : TensorElementType::Int16;
+    return impl_->exportTensor(ExportID::QuantizedState, type,
+                               {impl_->cfg.numWorlds, QUANT_STATE_WIDTH});
+}
+
+Tensor Manager::observationHistoryTensor() const
+{
+    if (!impl_->cfg.observationHistory) {
+        FATAL("Observation history was not enabled in Manager::Config");
+    }
+
+    return impl_->exportTensor(ExportID::ObservationHistory,
+                               TensorElementType::Float32,
+                               {impl_->cfg.numWorlds, OBS_HISTORY_FRAMES,
+                                ROLLOUT_OBS_DIM});
+}
+
+Tensor Manager::courtZoneTensor() const
+{
+    return impl_->exportTensor(ExportID::CourtZone, TensorElementType::Int32,
+                               {impl_->cfg.numWorlds, impl_->cfg.numPlayers, 2});
+}
+
+Tensor Manager::pairwiseGeometryTensor() const
+{
+    return impl_->exportTensor(ExportID::PairwiseGeometry,
+                               TensorElementType::Float32,
+                               {impl_->cfg.numWorlds,
+                                sizeof(PairwiseGeometry) / sizeof(float)});
+}
+
+void Manager::startRollout(uint32_t horizon)
+{
+    RolloutStorage &rollout = impl_->rollout;
+    if (horizon != rollout.horizon) {
+        uint64_t num_worlds = impl_->cfg.numWorlds;
+        uint64_t num_agents = num_worlds * ACTIVE_PLAYERS;
+        rollout.horizon = horizon;
+        rollout.observations.assign(horizon * num_worlds * ROLLOUT_OBS_DIM, 0.f);
+        rollout.actions.assign(horizon * num_agents * 5, 0.f);
+        rollout.choices.assign(horizon * num_agents, 0);
+        rollout.rewards.assign(horizon * num_agents, 0.f);
+        rollout.dones.assign(horizon * num_worlds, 0.f);
+        rollout.active.assign(horizon * num_worlds, 0.f);
+        rollout.values.assign((horizon + 1) * num_agents, 0.f);
+        rollout.advantages.assign(horizon * num_agents, 0.f);
+        rollout.returns.assign(horizon * num_agents, 0.f);
+        rollout.nextValues.assign(num_agents, 0.f);
+        rollout.running.assign(num_agents, 0.f);
+    }
+    rollout.cursor = 0;
+}
+
+uint32_t Manager::rolloutSteps() const
+{
+    return impl_->rollout.cursor;
+}
+
+// Backward scan over time, each step is one pass over every agent's
+// contiguous row so the inner loop vectorizes. A frozen world's step is
+// skipped: zero advantage, and the scan carries over it unchanged.
+void Manager::computeAdvantages(float gamma, float lambda)
+{
+    RolloutStorage &rollout = impl_->rollout;
+    uint64_t num_worlds = impl_->cfg.numWorlds;
+    uint64_t num_agents = num_worlds * ACTIVE_PLAYERS;
+
+    const float *rewards = rollout.rewards.data();
+    const float *values = rollout.values.data();
+    float *advantages = rollout.advantages.data();
+    float *returns = rollout.returns.data();
+
+    // Only the collected steps, the bootstrap value sits right after them
+    uint32_t num_steps = rollout.cursor;
+    float *next_values = rollout.nextValues.data();
+    float *running = rollout.running.data();
+    memcpy(next_values, values + num_steps * num_agents,
+           sizeof(float) * num_agents);
+    memset(running, 0, sizeof(float) * num_agents);
+
+    for (int64_t t = (int64_t)num_steps - 1; t >= 0; t--) {
+        uint64_t row = t * num_agents;
+        const float *dones = rollout.dones.data() + t * num_worlds;
+        const float *active = rollout.active.data() + t * num_worlds;
+
+        for (uint64_t i = 0; i < num_agents; i++) {
+            bool ran = active[i / ACTIVE_PLAYERS] != 0.f;
+            float not_done = 1.f - dones[i / ACTIVE_PLAYERS];
+            float value = values[row + i];
+            float delta = rewards[row + i] +
+                gamma * next_values[i] * not_done - value;
+            float advantage = delta + gamma * lambda * not_done * running[i];
+            running[i] = ran ? advantage : running[i];
+            next_values[i] = ran ? value : next_values[i];
+            advantages[row + i] = ran ? advantage : 0.f;
+            returns[row + i] = ran ? advantage + value : value;
+        }
+    }
+}
+
+static inline Tensor rolloutTensor(void *ptr, TensorElementType type,
+                                   Span<const int64_t> dims)
+{
+    return Tensor(ptr, type, dims, Optional<int>::none());
+}
+
+Tensor Manager::rolloutObservations() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.observations.data(),
+        TensorElementType::Float32,
+        {rollout.horizon, impl_->cfg.numWorlds, ROLLOUT_OBS_DIM});
+}
+
+Tensor Manager::rolloutActions() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.actions.data(),
+        TensorElementType::Float32,
+        {rollout.horizon, impl_->cfg.numWorlds, ACTIVE_PLAYERS, 5});
+}
+
+Tensor Manager::rolloutChoices() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.choices.data(),
+        TensorElementType::Int32,
+        {rollout.horizon, impl_->cfg.numWorlds, ACTIVE_PLAYERS});
+}
+
+Tensor Manager::rolloutRewards() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.rewards.data(),
+        TensorElementType::Float32,
+        {rollout.horizon, impl_->cfg.numWorlds, ACTIVE_PLAYERS});
+}
+
+Tensor Manager::rolloutDones() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.dones.data(),
+        TensorElementType::Float32,
+        {rollout.horizon, impl_->cfg.numWorlds});
+}
+
+Tensor Manager::rolloutActive() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.active.data(),
+        TensorElementType::Float32,
+        {rollout.horizon, impl_->cfg.numWorlds});
+}
+
+Tensor Manager::rolloutValues() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.values.data(),
+        TensorElementType::Float32,
+        {rollout.horizon + 1, impl_->cfg.numWorlds, ACTIVE_PLAYERS});
+}
+
+Tensor Manager::rolloutAdvantages() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.advantages.data(),
+        TensorElementType::Float32,
+        {rollout.horizon, impl_->cfg.numWorlds, ACTIVE_PLAYERS});
+}
+
+Tensor Manager::rolloutReturns() const
+{
+    const RolloutStorage &rollout = impl_->rollout;
+    return rolloutTensor((void *)rollout.returns.data(),
+        TensorElementType::Float32,
+        {rollout.horizon, impl_->cfg.numWorlds, ACTIVE_PLAYERS});
+}
 
+Tensor Manager::policyIdTensor() const
+{
+    return impl_->exportTensor(ExportID::PolicyID, TensorElementType::Int32,
+                               {impl_->cfg.numWorlds, 2});
+}
+
+static constexpr int PLAYERS_PER_TEAM = FIRST_TEAM2_PLAYER;
+
+// Team 2's canonical frame is the court turned 180 degrees about center
+// court. Unlike mirroring x alone this keeps the turning direction, so om
+// and omdes are unchanged, and the transform is its own inverse.
+static inline float halfTurn(float angle)
+{
+    return wrapAngle(angle + (float)PI);
+}
+
+static inline int32_t canonicalPlayer(int32_t id)
+{
+    return id < 0 ? id :
+        (id + ACTIVE_PLAYERS - FIRST_TEAM2_PLAYER) % ACTIVE_PLAYERS;
+}
+
+// Rewrites one ROLLOUT_OBS_DIM row as team 2 sees it
+static void canonicalizeTeam2Observation(float *obs)
+{
+    float players[ACTIVE_PLAYERS * 6];
+    memcpy(players, obs, sizeof(players));
+    for (int id = 0; id < ACTIVE_PLAYERS; id++) {
+        const float *src = players + id * 6;
+        float *dst = obs + canonicalPlayer(id) * 6;
+        dst[0] = -src[0];
+        dst[1] = -src[1];
+        dst[2] = halfTurn(src[2]);
+        dst[3] = src[3];
+        dst[4] = src[4];
+        dst[5] = halfTurn(src[5]);
+    }
+
+    float *ball = obs + ACTIVE_PLAYERS * 6;
+    ball[0] = -ball[0];
+    ball[1] = -ball[1];
+    ball[2] = halfTurn(ball[2]);
+
+    // heldBy, whoShot, whoPassed
+    for (int i = 4; i < 7; i++) {
+        ball[i] = (float)canonicalPlayer((int32_t)ball[i]);
+    }
+    if (ball[7] == (float)T1_NEED_TO_INBOUND) {
+        ball[7] = (float)T2_NEED_TO_INBOUND;
+    } else if (ball[7] == (float)T2_NEED_TO_INBOUND) {
+        ball[7] = (float)T1_NEED_TO_INBOUND;
+    }
+    std::swap(ball[8], ball[9]);
+}
+
+static void halfTurnActions(float *actions)
+{
+    for (int i = 0; i < PLAYERS_PER_TEAM; i++) {
+        float *action = actions + i * 5;
+        action[1] = halfTurn(action[1]);
+        action[3] = halfTurn(action[3]);
+    }
+}
+
+PolicyBatches & Manager::Impl::allocPolicyBatches()
+{
+    uint64_t num_slots = (uint64_t)cfg.numWorlds * 2;
+    if (policyBatches.slots.size() != num_slots) {
+        policyBatches.offsets.assign(1, 0);
+        policyBatches.teamPolicies.resize(num_slots);
+        policyBatches.slots.assign(num_slots, 0);
+        policyBatches.observations.assign(num_slots * ROLLOUT_OBS_DIM, 0.f);
+        policyBatches.actions.assign(num_slots * PLAYERS_PER_TEAM * 5, 0.f);
+        policyBatches.choices.assign(num_slots * PLAYERS_PER_TEAM, 0);
+        policyBatches.worldObservations.assign(
+            (uint64_t)cfg.numWorlds * ROLLOUT_OBS_DIM, 0.f);
+        policyBatches.courtActions.clear();
+    }
+    return policyBatches;
+}
+
+// Counting sort of the (world, team) slots by policy, then one row copy per
+// slot. Each team's players are consecutive in the Action export.
+void Manager::gatherPolicyBatches(uint32_t num_policies)
+{
+    PolicyBatches &batches = impl_->allocPolicyBatches();
+    uint64_t num_worlds = impl_->cfg.numWorlds;
+    uint64_t num_slots = num_worlds * 2;
+
+    memcpy(batches.teamPolicies.data(),
+           impl_->hostExport(ExportID::PolicyID, sizeof(int32_t) * num_slots),
+           sizeof(int32_t) * num_slots);
+    const int32_t *team_policies = batches.teamPolicies.data();
+
+    batches.offsets.assign(num_policies + 1, 0);
+    for (uint64_t s = 0; s < num_slots; s++) {
+        int32_t policy = team_policies[s];
+        if (policy >= 0 && policy < (int32_t)num_policies) {
+            batches.offsets[policy + 1] += 1;
+        }
+    }
+    for (uint32_t p = 0; p < num_policies; p++) {
+        batches.offsets[p + 1] += batches.offsets[p];
+    }
+
+    std::vector<int64_t> cursor(batches.offsets.begin(),
+                                batches.offsets.end() - 1);
+    for (uint64_t s = 0; s < num_slots; s++) {
+        int32_t policy = team_policies[s];
+        if (policy >= 0 && policy < (int32_t)num_policies) {
+            batches.slots[cursor[policy]++] = (int32_t)s;
+        }
+    }
+
+    impl_->writeObservations(batches.worldObservations.data());
+    uint64_t num_rows = batches.offsets.back();
+    bool canonical = impl_->cfg.teamCanonical;
+    // A memcpy per row, serial like scatterTeamRows
+    for (uint64_t row = 0; row < num_rows; row++) {
+        uint64_t world = batches.slots[row] / 2;
+        float *obs = batches.observations.data() + row * ROLLOUT_OBS_DIM;
+        memcpy(obs,
+               batches.worldObservations.data() + world * ROLLOUT_OBS_DIM,
+               sizeof(float) * ROLLOUT_OBS_DIM);
+        if (canonical && batches.slots[row] % 2 == 1) {
+            canonicalizeTeam2Observation(obs);
+        }
+    }
+
+    // Prefill with what the players are doing now, so a policy that only
+    // sets some of the fields leaves the rest alone
+    uint64_t num_agents = num_worlds * ACTIVE_PLAYERS;
+    auto *actions = (const Action *)impl_->hostExport(ExportID::Action,
+        sizeof(Action) * num_agents);
+    for (uint64_t row = 0; row < num_rows; row++) {
+        uint64_t first = (uint64_t)batches.slots[row] * PLAYERS_PER_TEAM;
+        float *dst = batches.actions.data() + row * PLAYERS_PER_TEAM * 5;
+        memcpy(dst, actions + first, sizeof(Action) * PLAYERS_PER_TEAM);
+        if (canonical && batches.slots[row] % 2 == 1) {
+            halfTurnActions(dst);
+        }
+    }
+
+    auto *choices = (const int32_t *)impl_->hostExport(ExportID::Choice,
+        sizeof(int32_t) * num_agents);
+    for (uint64_t row = 0; row < num_rows; row++) {
+        uint64_t first = (uint64_t)batches.slots[row] * PLAYERS_PER_TEAM;
+        memcpy(batches.choices.data() + row * PLAYERS_PER_TEAM,
+               choices + first, sizeof(int32_t) * PLAYERS_PER_TEAM);
+    }
+}
+
+void Manager::scatterPolicyBatches()
+{
+    PolicyBatches &batches = impl_->allocPolicyBatches();
+    const float *actions = batches.actions.data();
+
+    // Back to court coordinates in a copy, the trainer's rows stay as
+    // written
+    if (impl_->cfg.teamCanonical) {
+        uint64_t num_rows = batches.offsets.back();
+        uint64_t row_elems = PLAYERS_PER_TEAM * 5;
+        batches.courtActions.resize(batches.actions.size());
+        memcpy(batches.courtActions.data(), actions,
+               sizeof(float) * num_rows * row_elems);
+        for (uint64_t row = 0; row < num_rows; row++) {
+            if (batches.slots[row] % 2 == 1) {
+                halfTurnActions(batches.courtActions.data() + row * row_elems);
+            }
+        }
+        actions = batches.courtActions.data();
+    }
+
+    impl_->scatterTeamRows(ExportID::Action, actions,
+                           PLAYERS_PER_TEAM * 5);
+    impl_->scatterTeamRows(ExportID::Choice, batches.choices.data(),
+                           PLAYERS_PER_TEAM);
+}
+
+Tensor Manager::policyOffsets() const
+{
+    PolicyBatches &batches = impl_->allocPolicyBatches();
+    return Tensor(batches.offsets.data(), TensorElementType::Int64,
+        {(int64_t)batches.offsets.size()}, Optional<int>::none());
+}
+
+Tensor Manager::policyObservations() const
+{
+    PolicyBatches &batches = impl_->allocPolicyBatches();
+    return Tensor(batches.observations.data(), TensorElementType::Float32,
+        {impl_->cfg.numWorlds * 2, ROLLOUT_OBS_DIM}, Optional<int>::none());
+}
+
+Tensor Manager::policyActions() const
+{
+    PolicyBatches &batches = impl_->allocPolicyBatches();
+    return Tensor(batches.actions.data(), TensorElementType::Float32,
+        {impl_->cfg.numWorlds * 2, PLAYERS_PER_TEAM, 5},
+        Optional<int>::none());
+}
+
+Tensor Manager::policyChoices() const
+{
+    PolicyBatches &batches = impl_->allocPolicyBatches();
+    return Tensor(batches.choices.data(), TensorElementType::Int32,
+        {impl_->cfg.numWorlds * 2, PLAYERS_PER_TEAM}, Optional<int>::none());
+}
+
+Tensor Manager::policySlots() const
+{
+    PolicyBatches &batches = impl_->allocPolicyBatches();
+    return Tensor(batches.slots.data(), TensorElementType::Int32,
+        {impl_->cfg.numWorlds * 2}, Optional<int>::none());
+}
+
+// madrona stores an Entity and a WorldID column next to every archetype's
+// components, singletons included
+static constexpr uint64_t ROW_OVERHEAD_BYTES =
+    sizeof(Entity) + sizeof(WorldID);
+
+template <typename T>
+static Manager::MemoryUsage playerColumn(const char *name)
+{
+    return Manager::MemoryUsage {name, sizeof(T) * ACTIVE_PLAYERS};
+}
+
+template <typename T>
+static Manager::MemoryUsage singletonTable(const char *name)
+{
+    return Manager::MemoryUsage {name, sizeof(T) + ROW_OVERHEAD_BYTES};
+}
+
+std::vector<Manager::MemoryUsage> Manager::memoryReport() const
+{
+    return memoryReport(impl_->cfg);
+}
+
+std::vector<Manager::MemoryUsage> Manager::memoryReport(const Config &cfg)
+{
+    std::vector<MemoryUsage> report {
+        playerColumn<Action>("Action"),
+        playerColumn<CourtPos>("CourtPos"),
+        playerColumn<PlayerID>("PlayerID"),
+        playerColumn<PlayerStatus>("PlayerStatus"),
+        playerColumn<PlayerDecision>("PlayerDecision"),
+        playerColumn<FoulID>("FoulID"),
+        playerColumn<StaticPlayerAttributes>("StaticPlayerAttributes"),
+        playerColumn<MacroCommand>("MacroCommand"),
+        playerColumn<MacroParams>("MacroParams"),
+        playerColumn<CourtZone>("CourtZone"),
+        {"Agent rows", ROW_OVERHEAD_BYTES * ACTIVE_PLAYERS},
+        singletonTable<BallState>("BallState"),
+        singletonTable<BallStatus>("BallStatus"),
+        singletonTable<Scorecard>("Scorecard"),
+        singletonTable<AgentList>("AgentList"),
+        singletonTable<WorldReset>("WorldReset"),
+        singletonTable<WorldActive>("WorldActive"),
+        singletonTable<ScenarioSelection>("ScenarioSelection"),
+        singletonTable<GameEventLog>("GameEventLog"),
+        singletonTable<BoxScore>("BoxScore"),
+        singletonTable<StateHash>("StateHash"),
+        singletonTable<SubstepSchedule>("SubstepSchedule"),
+        singletonTable<SubstepStats>("SubstepStats"),
+        singletonTable<TeamPolicies>("TeamPolicies"),
+        singletonTable<PairwiseGeometry>("PairwiseGeometry"),
+        {"Sim", sizeof(Sim)},
+    };
+
+    if (cfg.observationPrecision != ObservationPrecision::Float32) {
+        report.push_back(singletonTable<QuantizedState>("QuantizedState"));
+    }
+
+    if (cfg.observationHistory) {
+        report.push_back(
+            singletonTable<ObservationHistory>("ObservationHistory"));
+    }
+
+    if (cfg.enableRaster) {
+        report.push_back({"raster", rasterBytesPerWorld(cfg)});
+    }
+
+    return report;
+}
+
+}
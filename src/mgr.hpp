@@ -6,11 +6,13 @@
 #endif
 
 #include <memory>
+#include <vector>
 
 #include <madrona/py/utils.hpp>
 #include <madrona/exec_mode.hpp>
 
 #include "court.hpp"
+#include "scenario_bank.hpp"
 
 namespace madsimple {
 
@@ -23,6 +25,59 @@ public:
         uint32_t numWorlds;
         uint32_t numPlayers;
         int gpuID;
+        // Optional tuned shot tables written by saveShotModel, nullptr or
+        // empty uses the built-in defaults
+        const char *shotModelPath = nullptr;
+        // Optional initial state distribution, each world samples it with
+        // its own generator seeded from seed and the world index
+        const CourtRandomization *randomization = nullptr;
+        uint32_t seed = 0;
+        // Optional bank from scripts/compile_scenarios.py, resets then load
+        // one of its scenarios instead of the court or randomization spec
+        const char *scenarioBankPath = nullptr;
+        ScenarioSampling scenarioSampling = ScenarioSampling::Uniform;
+        uint32_t curriculumEpisodesPerStage = 1000;
+        // Optional top-down image observation, see RasterChannel
+        bool enableRaster = false;
+        uint32_t rasterWidth = 48;
+        uint32_t rasterHeight = 26;
+        // Optional POSIX shared memory name (e.g. "/bball_sim") that state
+        // is mirrored into after every step, CPU only. With
+        // sharedMemoryActions the Action and Choice buffers are read back
+        // from it instead, so another process can drive the simulator.
+        const char *sharedMemoryName = nullptr;
+        bool sharedMemoryActions = false;
+        // Bit-exact runs for a given seed and action stream, independent of
+        // numThreads: players that touch shared state are processed in ID
+        // order and stateHashTensor is filled every step
+        bool deterministic = false;
+        // CPU worker threads, 0 uses every hardware thread
+        uint32_t numThreads = 0;
+        // Fewer movement/collision substeps in worlds where no players can
+        // touch this tick, false always runs COLLISION_CHECK_STEPS
+        bool adaptiveSubsteps = true;
+        // Also export player, ball and action state as fp16 or int16 in
+        // quantizedStateTensor, see QUANT_* in consts.hpp for int16 scales
+        ObservationPrecision observationPrecision =
+            ObservationPrecision::Float32;
+        // Faster startup at high world counts: the worlds only create their
+        // entities and the initial state is then written straight into the
+        // exported buffers for all worlds at once, split over numThreads
+        // host threads. Ignored with randomization or a scenario bank,
+        // which sample each world's state separately.
+        bool lazyInit = false;
+        // Optional [numWorlds, ACTIVE_PLAYERS, 6] CourtPos rows for the
+        // first episode under lazyInit, nullptr starts every world from
+        // the CourtState. Resets always go back to the CourtState. Only
+        // read when lazyInit is in effect, the Python bindings reject any
+        // other combination.
+        const float *initialPlayerStates = nullptr;
+        // Keep the last OBS_HISTORY_FRAMES observations of every world in
+        // observationHistoryTensor
+        bool observationHistory = false;
+        // gatherPolicyBatches emits every team's rows in its own frame,
+        // see policyObservations, so one policy can drive both sides
+        bool teamCanonical = false;
     };
 
     // add initial conditions to manager constructor
@@ -31,6 +86,10 @@ public:
 
     MGR_EXPORT void step();
 
+    // Writes the built-in shot tables in the format shotModelPath expects,
+    // as a starting point for tuning
+    MGR_EXPORT static void saveDefaultShotModel(const char *path);
+
     // new playerTensor
     MGR_EXPORT madrona::py::Tensor playerTensor() const;
     MGR_EXPORT madrona::py::Tensor actionTensor() const;
@@ -41,6 +100,105 @@ public:
     MGR_EXPORT madrona::py::Tensor choiceTensor() const;
     MGR_EXPORT madrona::py::Tensor foulCallTensor() const;
     MGR_EXPORT madrona::py::Tensor resetTensor() const;
+    MGR_EXPORT madrona::py::Tensor scenarioTensor() const;
+    MGR_EXPORT madrona::py::Tensor rasterTensor() const;
+    MGR_EXPORT madrona::py::Tensor eventTensor() const;
+    MGR_EXPORT madrona::py::Tensor boxScoreTensor() const;
+    MGR_EXPORT madrona::py::Tensor stateHashTensor() const;
+    MGR_EXPORT madrona::py::Tensor substepStatsTensor() const;
+    // [numWorlds, 1] int32, worlds set to 0 are frozen by step() until
+    // they are set back to 1
+    MGR_EXPORT madrona::py::Tensor activeTensor() const;
+    // [numWorlds, numPlayers, 3] int32 (type, target, status) and
+    // [numWorlds, numPlayers, 4] float (x, y, speed, openDistance), see
+    // MacroType
+    MGR_EXPORT madrona::py::Tensor macroCommandTensor() const;
+    MGR_EXPORT madrona::py::Tensor macroParamsTensor() const;
+    // [numWorlds, QUANT_STATE_WIDTH] Float16 or Int16, refreshed after
+    // every step. Only available when observationPrecision isn't Float32.
+    MGR_EXPORT madrona::py::Tensor quantizedStateTensor() const;
+    // [numWorlds, OBS_HISTORY_FRAMES, ROLLOUT_OBS_DIM] float, frame 0 is
+    // the state after the latest step and older frames follow. A world
+    // that was reset has the new episode's first state in every frame.
+    // Only available when observationHistory is set.
+    MGR_EXPORT madrona::py::Tensor observationHistoryTensor() const;
+    // [numWorlds, 2 * ACTIVE_PLAYERS^2 + ACTIVE_PLAYERS] float: the
+    // player distance matrix, the closing speed matrix (positive when two
+    // players approach each other) and each player's distance to the ball,
+    // from the state after the latest step. See PairwiseGeometry.
+    MGR_EXPORT madrona::py::Tensor pairwiseGeometryTensor() const;
+    // [numWorlds, numPlayers, 2] int32 (COURT_ZONE_* bits, closest
+    // INBOUND_POINTS index) of each player's position after the latest step
+    MGR_EXPORT madrona::py::Tensor courtZoneTensor() const;
+
+    // Sums every world's box score into a [numPlayers, NUM_BOX_SCORE_STATS]
+    // int64 host tensor, reused by the next call. With reset the per world
+    // counters start over, so repeated calls return disjoint intervals.
+    MGR_EXPORT madrona::py::Tensor boxScoreTotals(bool reset);
+
+    // Rollout collection for on-policy training. After startRollout(T),
+    // each of the next T step() calls copies the pre-step observation
+    // (ROLLOUT_OBS_DIM floats per world), the actions and choices it ran
+    // with, whether the world was reset and whether it was active at all
+    // into slot t of host side [T, numWorlds, ...] buffers. Frozen worlds'
+    // rows are kept but marked inactive, GAE skips them. The learner fills
+    // rolloutRewards[t] after step t and rolloutValues[t] (plus the
+    // bootstrap value at T), then computeAdvantages runs GAE(lambda) over
+    // the whole rollout.
+    // The rollout tensors are CPU tensors aliasing the buffers, they stay
+    // valid until startRollout is called with a different horizon.
+    MGR_EXPORT void startRollout(uint32_t horizon);
+    MGR_EXPORT uint32_t rolloutSteps() const;
+    MGR_EXPORT void computeAdvantages(float gamma, float lambda);
+    MGR_EXPORT madrona::py::Tensor rolloutObservations() const;
+    MGR_EXPORT madrona::py::Tensor rolloutActions() const;
+    MGR_EXPORT madrona::py::Tensor rolloutChoices() const;
+    MGR_EXPORT madrona::py::Tensor rolloutRewards() const;
+    MGR_EXPORT madrona::py::Tensor rolloutDones() const;
+    MGR_EXPORT madrona::py::Tensor rolloutActive() const;
+    MGR_EXPORT madrona::py::Tensor rolloutValues() const;
+    MGR_EXPORT madrona::py::Tensor rolloutAdvantages() const;
+    MGR_EXPORT madrona::py::Tensor rolloutReturns() const;
+
+    // Policy routing for self-play and league training. policyIdTensor is
+    // [numWorlds, 2] int32, the policy driving each team (negative: none).
+    // gatherPolicyBatches packs the ROLLOUT_OBS_DIM observation of every
+    // (world, team) into rows sorted by policy, policy p owning rows
+    // [offsets[p], offsets[p + 1]). The trainer runs one inference per
+    // policy on its rows, writes the action and choice rows (prefilled
+    // with the current ones) and scatterPolicyBatches writes them back
+    // into the Action / PlayerDecision exports of that team's players.
+    MGR_EXPORT madrona::py::Tensor policyIdTensor() const;
+    MGR_EXPORT void gatherPolicyBatches(uint32_t num_policies);
+    MGR_EXPORT void scatterPolicyBatches();
+    // [numPolicies + 1] int64, valid after gatherPolicyBatches
+    MGR_EXPORT madrona::py::Tensor policyOffsets() const;
+    // [numWorlds * 2, ...] CPU tensors, rows past offsets[numPolicies]
+    // are unused. slots holds world * 2 + team for each row.
+    //
+    // With teamCanonical, every row is seen as team 1, which attacks
+    // LEFT_HOOP_X. Team 2 rows are rotated 180 degrees about center
+    // court, so x, y negate and headings turn by pi. Their players come
+    // first, so observation slots 0-1 are the team and 2-3 its opponents.
+    // Player ids in the ball status are those slots, the inbound states
+    // and scores are swapped. The thdes and pass_th of team 2's action
+    // rows are turned back by scatterPolicyBatches.
+    MGR_EXPORT madrona::py::Tensor policyObservations() const;
+    MGR_EXPORT madrona::py::Tensor policyActions() const;
+    MGR_EXPORT madrona::py::Tensor policyChoices() const;
+    MGR_EXPORT madrona::py::Tensor policySlots() const;
+
+    // Approximate simulator memory per world, one entry per component
+    // table, singleton and per world buffer. Rows also pay for madrona's
+    // Entity and WorldID columns, which are folded into each entry. Only
+    // depends on the config, so the static version needs no Manager.
+    struct MemoryUsage {
+        const char *name;
+        uint64_t bytesPerWorld;
+    };
+    MGR_EXPORT std::vector<MemoryUsage> memoryReport() const;
+    MGR_EXPORT static std::vector<MemoryUsage> memoryReport(
+        const Config &cfg);
 
 private:
     struct Impl;
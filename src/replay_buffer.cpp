@@ -0,0 +1,331 @@
+#include "replay_buffer.hpp"
+
+#include <madrona/utils.hpp>
+
+#ifdef MADRONA_CUDA_SUPPORT
+#include <madrona/cuda_utils.hpp>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace madrona;
+using namespace madrona::py;
+
+namespace madsimple {
+
+static inline uint64_t alignBatchOffset(uint64_t offset)
+{
+    return (offset + 63) & ~(uint64_t)63;
+}
+
+static char * allocBatch(uint64_t num_bytes)
+{
+#ifdef MADRONA_CUDA_SUPPORT
+    // Pinned, so .to('cuda', non_blocking=True) on a batch is a real async copy
+    return (char *)cu::allocStaging(num_bytes);
+#else
+    return (char *)malloc(num_bytes);
+#endif
+}
+
+static void freeBatch(char *ptr)
+{
+#ifdef MADRONA_CUDA_SUPPORT
+    cu::deallocCPU(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+ReplayBuffer::ReplayBuffer(const Config &cfg)
+    : cfg_(cfg),
+      next_(0),
+      size_(0),
+      states_((uint64_t)cfg.capacity * cfg.stateDim),
+      contActions_((uint64_t)cfg.capacity * cfg.contActionDim),
+      discActions_((uint64_t)cfg.capacity * cfg.discActionDim),
+      rewards_(cfg.capacity),
+      nextStates_((uint64_t)cfg.capacity * cfg.stateDim),
+      dones_(cfg.capacity),
+      tree_(),
+      treeLeaves_(1),
+      maxPriority_(1.0),
+      rng_(cfg.seed)
+{
+    if (cfg.capacity == 0 || cfg.maxBatchSize == 0) {
+        FATAL("ReplayBuffer needs a nonzero capacity and maxBatchSize");
+    }
+
+    if (cfg.prioritized) {
+        while (treeLeaves_ < cfg.capacity) {
+            treeLeaves_ *= 2;
+        }
+        tree_.resize(2 * (uint64_t)treeLeaves_, 0.0);
+    }
+
+    uint64_t batch = cfg.maxBatchSize;
+    uint64_t state_offset = 0;
+    uint64_t cont_offset = alignBatchOffset(
+        state_offset + batch * cfg.stateDim * sizeof(float));
+    uint64_t disc_offset = alignBatchOffset(
+        cont_offset + batch * cfg.contActionDim * sizeof(float));
+    uint64_t reward_offset = alignBatchOffset(
+        disc_offset + batch * cfg.discActionDim * sizeof(int32_t));
+    uint64_t next_offset = alignBatchOffset(
+        reward_offset + batch * sizeof(float));
+    uint64_t done_offset = alignBatchOffset(
+        next_offset + batch * cfg.stateDim * sizeof(float));
+    uint64_t index_offset = alignBatchOffset(
+        done_offset + batch * sizeof(float));
+    uint64_t weight_offset = alignBatchOffset(
+        index_offset + batch * sizeof(int64_t));
+    uint64_t num_bytes = alignBatchOffset(
+        weight_offset + batch * sizeof(float));
+
+    batchData_ = allocBatch(num_bytes);
+    memset(batchData_, 0, num_bytes);
+    batchStates_ = (float *)(batchData_ + state_offset);
+    batchContActions_ = (float *)(batchData_ + cont_offset);
+    batchDiscActions_ = (int32_t *)(batchData_ + disc_offset);
+    batchRewards_ = (float *)(batchData_ + reward_offset);
+    batchNextStates_ = (float *)(batchData_ + next_offset);
+    batchDones_ = (float *)(batchData_ + done_offset);
+    batchIndices_ = (int64_t *)(batchData_ + index_offset);
+    batchWeights_ = (float *)(batchData_ + weight_offset);
+}
+
+ReplayBuffer::~ReplayBuffer()
+{
+    freeBatch(batchData_);
+}
+
+// Copies rows [src_row, src_row + num_rows) of a row major source into the
+// ring, which may wrap past the end of the column
+template <typename T>
+static void copyIntoRing(std::vector<T> &column, const T *src,
+                         uint32_t dim, uint32_t dst_row, uint32_t num_rows,
+                         uint32_t capacity)
+{
+    if (dim == 0) {
+        return;
+    }
+
+    uint32_t first = std::min(num_rows, capacity - dst_row);
+    memcpy(column.data() + (uint64_t)dst_row * dim, src,
+           sizeof(T) * first * dim);
+    if (first < num_rows) {
+        memcpy(column.data(), src + (uint64_t)first * dim,
+               sizeof(T) * (num_rows - first) * dim);
+    }
+}
+
+void ReplayBuffer::add(uint32_t num_rows,
+                       const float *state,
+                       const float *cont_action,
+                       const int32_t *disc_action,
+                       const float *reward,
+                       const float *next_state,
+                       const float *done)
+{
+    // Only the newest capacity rows would survive anyway
+    if (num_rows > cfg_.capacity) {
+        uint32_t skip = num_rows - cfg_.capacity;
+        state += (uint64_t)skip * cfg_.stateDim;
+        cont_action += (uint64_t)skip * cfg_.contActionDim;
+        if (disc_action != nullptr) {
+            disc_action += (uint64_t)skip * cfg_.discActionDim;
+        }
+        reward += skip;
+        next_state += (uint64_t)skip * cfg_.stateDim;
+        done += skip;
+        num_rows = cfg_.capacity;
+    }
+
+    uint32_t capacity = cfg_.capacity;
+    copyIntoRing(states_, state, cfg_.stateDim, next_, num_rows, capacity);
+    copyIntoRing(contActions_, cont_action, cfg_.contActionDim, next_,
+                 num_rows, capacity);
+    if (disc_action != nullptr) {
+        copyIntoRing(discActions_, disc_action, cfg_.discActionDim, next_,
+                     num_rows, capacity);
+    }
+    copyIntoRing(rewards_, reward, 1, next_, num_rows, capacity);
+    copyIntoRing(nextStates_, next_state, cfg_.stateDim, next_, num_rows,
+                 capacity);
+    copyIntoRing(dones_, done, 1, next_, num_rows, capacity);
+
+    if (cfg_.prioritized) {
+        for (uint32_t i = 0; i < num_rows; i++) {
+            setPriority((next_ + i) % capacity, maxPriority_);
+        }
+    }
+
+    next_ = (next_ + num_rows) % capacity;
+    size_ = std::min(size_ + num_rows, capacity);
+}
+
+void ReplayBuffer::setPriority(uint32_t idx, double priority)
+{
+    uint32_t node = treeLeaves_ + idx;
+    double delta = std::pow(priority, (double)cfg_.alpha) - tree_[node];
+    while (node >= 1) {
+        tree_[node] += delta;
+        node /= 2;
+    }
+}
+
+// Leaf whose prefix sum interval contains mass
+uint32_t ReplayBuffer::findPrefixSum(double mass) const
+{
+    uint32_t node = 1;
+    while (node < treeLeaves_) {
+        uint32_t left = 2 * node;
+        if (mass < tree_[left] || tree_[left + 1] <= 0.0) {
+            node = left;
+        } else {
+            mass -= tree_[left];
+            node = left + 1;
+        }
+    }
+    // Rounding can land one past the filled region
+    return std::min(node - treeLeaves_, size_ - 1);
+}
+
+void ReplayBuffer::sample(uint32_t batch_size, float beta)
+{
+    if (batch_size > cfg_.maxBatchSize) {
+        FATAL("ReplayBuffer::sample: batch_size %u exceeds maxBatchSize %u",
+              batch_size, cfg_.maxBatchSize);
+    }
+    if (size_ == 0) {
+        FATAL("ReplayBuffer::sample: buffer is empty");
+    }
+
+    if (cfg_.prioritized) {
+        double total = tree_[1];
+        double segment = total / batch_size;
+        std::uniform_real_distribution<double> offset(0.0, segment);
+
+        double max_weight = 0.0;
+        for (uint32_t i = 0; i < batch_size; i++) {
+            uint32_t idx = findPrefixSum(segment * i + offset(rng_));
+            batchIndices_[i] = idx;
+
+            double prob = tree_[treeLeaves_ + idx] / total;
+            double weight = std::pow((double)size_ * prob, -(double)beta);
+            batchWeights_[i] = (float)weight;
+            max_weight = std::max(max_weight, weight);
+        }
+
+        for (uint32_t i = 0; i < batch_size; i++) {
+            batchWeights_[i] = (float)(batchWeights_[i] / max_weight);
+        }
+    } else {
+        std::uniform_int_distribution<uint32_t> pick(0, size_ - 1);
+        for (uint32_t i = 0; i < batch_size; i++) {
+            batchIndices_[i] = pick(rng_);
+            batchWeights_[i] = 1.f;
+        }
+    }
+
+    uint32_t state_dim = cfg_.stateDim;
+    uint32_t cont_dim = cfg_.contActionDim;
+    uint32_t disc_dim = cfg_.discActionDim;
+    for (uint32_t i = 0; i < batch_size; i++) {
+        uint64_t idx = (uint64_t)batchIndices_[i];
+        memcpy(batchStates_ + (uint64_t)i * state_dim,
+               states_.data() + idx * state_dim, sizeof(float) * state_dim);
+        memcpy(batchContActions_ + (uint64_t)i * cont_dim,
+               contActions_.data() + idx * cont_dim, sizeof(float) * cont_dim);
+        memcpy(batchDiscActions_ + (uint64_t)i * disc_dim,
+               discActions_.data() + idx * disc_dim,
+               sizeof(int32_t) * disc_dim);
+        batchRewards_[i] = rewards_[idx];
+        memcpy(batchNextStates_ + (uint64_t)i * state_dim,
+               nextStates_.data() + idx * state_dim,
+               sizeof(float) * state_dim);
+        batchDones_[i] = dones_[idx];
+    }
+}
+
+void ReplayBuffer::updatePriorities(uint32_t num_rows,
+                                    const int64_t *indices,
+                                    const float *priorities)
+{
+    if (!cfg_.prioritized) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < num_rows; i++) {
+        if (indices[i] < 0 || indices[i] >= (int64_t)size_) {
+            continue;
+        }
+
+        double priority = (double)std::abs(priorities[i]) + cfg_.epsilon;
+        maxPriority_ = std::max(maxPriority_, priority);
+        setPriority((uint32_t)indices[i], priority);
+    }
+}
+
+uint32_t ReplayBuffer::size() const
+{
+    return size_;
+}
+
+const ReplayBuffer::Config & ReplayBuffer::config() const
+{
+    return cfg_;
+}
+
+Tensor ReplayBuffer::stateBatch(uint32_t batch_size) const
+{
+    return Tensor(batchStates_, TensorElementType::Float32,
+        {(int64_t)batch_size, cfg_.stateDim}, Optional<int>::none());
+}
+
+Tensor ReplayBuffer::contActionBatch(uint32_t batch_size) const
+{
+    return Tensor(batchContActions_, TensorElementType::Float32,
+        {(int64_t)batch_size, cfg_.contActionDim}, Optional<int>::none());
+}
+
+Tensor ReplayBuffer::discActionBatch(uint32_t batch_size) const
+{
+    return Tensor(batchDiscActions_, TensorElementType::Int32,
+        {(int64_t)batch_size, cfg_.discActionDim}, Optional<int>::none());
+}
+
+Tensor ReplayBuffer::rewardBatch(uint32_t batch_size) const
+{
+    return Tensor(batchRewards_, TensorElementType::Float32,
+        {(int64_t)batch_size}, Optional<int>::none());
+}
+
+Tensor ReplayBuffer::nextStateBatch(uint32_t batch_size) const
+{
+    return Tensor(batchNextStates_, TensorElementType::Float32,
+        {(int64_t)batch_size, cfg_.stateDim}, Optional<int>::none());
+}
+
+Tensor ReplayBuffer::doneBatch(uint32_t batch_size) const
+{
+    return Tensor(batchDones_, TensorElementType::Float32,
+        {(int64_t)batch_size}, Optional<int>::none());
+}
+
+Tensor ReplayBuffer::indexBatch(uint32_t batch_size) const
+{
+    return Tensor(batchIndices_, TensorElementType::Int64,
+        {(int64_t)batch_size}, Optional<int>::none());
+}
+
+Tensor ReplayBuffer::weightBatch(uint32_t batch_size) const
+{
+    return Tensor(batchWeights_, TensorElementType::Float32,
+        {(int64_t)batch_size}, Optional<int>::none());
+}
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+#ifndef MGR_EXPORT
+#ifdef gridworld_madrona_mgr_EXPORTS
+#define MGR_EXPORT MADRONA_EXPORT
+#else
+#define MGR_EXPORT MADRONA_IMPORT
+#endif
+#endif
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <madrona/py/utils.hpp>
+
+namespace madsimple {
+
+// Fixed capacity transition store for the off-policy trainers. Every field
+// is its own preallocated column, transitions for all worlds are appended
+// with one memcpy per column and sampled batches are gathered into
+// preallocated (pinned when built with CUDA) buffers that the batch
+// tensors alias, so nothing is allocated per add or sample.
+//
+// With prioritized set, indices are drawn proportional to priority^alpha
+// from a sum tree (stratified over the batch) and importanceWeights holds
+// (N * P(i))^-beta normalized by the batch maximum. New transitions get the
+// largest priority seen so far.
+class ReplayBuffer {
+public:
+    struct Config {
+        uint32_t capacity;
+        uint32_t stateDim;
+        uint32_t contActionDim;
+        uint32_t discActionDim; // 0 for purely continuous agents
+        uint32_t maxBatchSize;
+        bool prioritized = false;
+        float alpha = 0.6f;
+        float epsilon = 1e-6f; // keeps zero TD error transitions sampleable
+        uint32_t seed = 0;
+    };
+
+    MGR_EXPORT ReplayBuffer(const Config &cfg);
+    MGR_EXPORT ~ReplayBuffer();
+
+    ReplayBuffer(const ReplayBuffer &) = delete;
+    ReplayBuffer & operator=(const ReplayBuffer &) = delete;
+
+    // Appends num_rows transitions from row major host arrays, overwriting
+    // the oldest ones once full. disc_action may be nullptr when
+    // discActionDim is 0.
+    MGR_EXPORT void add(uint32_t num_rows,
+                        const float *state,
+                        const float *cont_action,
+                        const int32_t *disc_action,
+                        const float *reward,
+                        const float *next_state,
+                        const float *done);
+
+    // Fills the batch tensors with batch_size transitions, batch_size must
+    // not exceed maxBatchSize. beta is only used when prioritized.
+    MGR_EXPORT void sample(uint32_t batch_size, float beta);
+
+    // Sets the priority of the transitions last returned by sample, e.g.
+    // to |td_error|
+    MGR_EXPORT void updatePriorities(uint32_t num_rows,
+                                     const int64_t *indices,
+                                     const float *priorities);
+
+    MGR_EXPORT uint32_t size() const;
+    MGR_EXPORT const Config & config() const;
+
+    // [batch, dim] views of the sample buffers, valid until the next sample
+    MGR_EXPORT madrona::py::Tensor stateBatch(uint32_t batch_size) const;
+    MGR_EXPORT madrona::py::Tensor contActionBatch(uint32_t batch_size) const;
+    MGR_EXPORT madrona::py::Tensor discActionBatch(uint32_t batch_size) const;
+    MGR_EXPORT madrona::py::Tensor rewardBatch(uint32_t batch_size) const;
+    MGR_EXPORT madrona::py::Tensor nextStateBatch(uint32_t batch_size) const;
+    MGR_EXPORT madrona::py::Tensor doneBatch(uint32_t batch_size) const;
+    MGR_EXPORT madrona::py::Tensor indexBatch(uint32_t batch_size) const;
+    MGR_EXPORT madrona::py::Tensor weightBatch(uint32_t batch_size) const;
+
+private:
+    void setPriority(uint32_t idx, double priority);
+    uint32_t findPrefixSum(double mass) const;
+
+    Config cfg_;
+    uint32_t next_;
+    uint32_t size_;
+
+    std::vector<float> states_;
+    std::vector<float> contActions_;
+    std::vector<int32_t> discActions_;
+    std::vector<float> rewards_;
+    std::vector<float> nextStates_;
+    std::vector<float> dones_;
+
+    // Sum tree over priority^alpha, leaves start at treeLeaves_
+    std::vector<double> tree_;
+    uint32_t treeLeaves_;
+    double maxPriority_;
+
+    // One allocation holding every batch column, see batchBytes
+    char *batchData_;
+    float *batchStates_;
+    float *batchContActions_;
+    int32_t *batchDiscActions_;
+    float *batchRewards_;
+    float *batchNextStates_;
+    float *batchDones_;
+    int64_t *batchIndices_;
+    float *batchWeights_;
+
+    std::mt19937_64 rng_;
+};
+
+}
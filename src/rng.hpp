@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+namespace madsimple {
+
+// PCG32 (XSH RR variant). Satisfies UniformRandomBitGenerator so it drops
+// into the <random> distributions, but keeps 16 bytes of state per world
+// instead of the ~5KB of std::mt19937.
+class WorldRNG {
+public:
+    using result_type = uint32_t;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    WorldRNG()
+        : state_(0x853c49e6748fea9bULL),
+          inc_(0xda3e39cb94b95bdbULL)
+    {}
+
+    void seed(std::seed_seq &seeds)
+    {
+        uint32_t words[4];
+        seeds.generate(words, words + 4);
+
+        state_ = 0;
+        // The increment has to be odd
+        inc_ = ((((uint64_t)words[2] << 32) | words[3]) << 1) | 1;
+        (*this)();
+        state_ += ((uint64_t)words[0] << 32) | words[1];
+        (*this)();
+    }
+
+    result_type operator()()
+    {
+        uint64_t old = state_;
+        state_ = old * 6364136223846793005ULL + inc_;
+        uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rot = (uint32_t)(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+
+private:
+    uint64_t state_;
+    uint64_t inc_;
+};
+
+}
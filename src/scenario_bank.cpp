@@ -0,0 +1,84 @@
+#include "scenario_bank.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace madsimple {
+
+bool mapScenarioBank(const char *path,
+                     ScenarioSampling sampling,
+                     uint32_t curriculum_episodes_per_stage,
+                     MappedScenarioBank &out)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+            (size_t)file_stat.st_size < sizeof(ScenarioBankHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t num_bytes = (size_t)file_stat.st_size;
+    void *mapping = mmap(nullptr, num_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    auto *header = (const ScenarioBankHeader *)mapping;
+    size_t expected_bytes = sizeof(ScenarioBankHeader) +
+        (size_t)header->numScenarios * (sizeof(Scenario) + sizeof(float));
+    if (header->magic != SCENARIO_BANK_MAGIC ||
+            header->version != SCENARIO_BANK_VERSION ||
+            header->numPlayers != ACTIVE_PLAYERS ||
+            header->numScenarios == 0 ||
+            num_bytes != expected_bytes) {
+        munmap(mapping, num_bytes);
+        return false;
+    }
+
+    auto *scenarios = (const Scenario *)(header + 1);
+    auto *weights = (const float *)(scenarios + header->numScenarios);
+
+    // Prefix sums so weighted picks are a binary search
+    float *cumulative = new float[header->numScenarios];
+    float total = 0.0f;
+    for (uint32_t i = 0; i < header->numScenarios; i++) {
+        total += weights[i] > 0.0f ? weights[i] : 0.0f;
+        cumulative[i] = total;
+    }
+
+    if (sampling == ScenarioSampling::Weighted && total <= 0.0f) {
+        delete[] cumulative;
+        munmap(mapping, num_bytes);
+        return false;
+    }
+
+    out.mapping = mapping;
+    out.numBytes = num_bytes;
+    out.cumulativeWeights = cumulative;
+    out.bank = ScenarioBank {
+        .scenarios = scenarios,
+        .cumulativeWeights = cumulative,
+        .numScenarios = (int32_t)header->numScenarios,
+        .sampling = sampling,
+        .curriculumEpisodesPerStage = curriculum_episodes_per_stage > 0 ?
+            curriculum_episodes_per_stage : 1,
+    };
+
+    return true;
+}
+
+void unmapScenarioBank(MappedScenarioBank &mapped)
+{
+    delete[] mapped.cumulativeWeights;
+    munmap(mapped.mapping, mapped.numBytes);
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef MGR_EXPORT
+#ifdef gridworld_madrona_mgr_EXPORTS
+#define MGR_EXPORT MADRONA_EXPORT
+#else
+#define MGR_EXPORT MADRONA_IMPORT
+#endif
+#endif
+
+#include <cstdint>
+#include <cstddef>
+
+#include <madrona/macros.hpp>
+
+#include "court.hpp"
+
+namespace madsimple {
+
+// On disk layout written by scripts/compile_scenarios.py:
+//   ScenarioBankHeader, Scenario[numScenarios], float weights[numScenarios]
+constexpr uint32_t SCENARIO_BANK_MAGIC = 0x4e435342; // "BSCN"
+constexpr uint32_t SCENARIO_BANK_VERSION = 1;
+
+struct ScenarioBankHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numScenarios;
+    uint32_t numPlayers;
+};
+
+// One compiled gamestate JSON
+struct Scenario {
+    Player players[ACTIVE_PLAYERS];
+    float ballX;
+    float ballY;
+    float ballTh;
+    float ballV;
+    int32_t whoHolds;
+    int32_t whoShot;
+};
+
+enum class ScenarioSampling : int32_t {
+    Uniform = 0,
+    Weighted = 1,
+    // Scenarios are ordered easiest first, one more is unlocked every
+    // curriculumEpisodesPerStage episodes (counted across all worlds)
+    Curriculum = 2,
+};
+
+// Read-only view shared by every world, the reset path only indexes into it
+struct ScenarioBank {
+    const Scenario *scenarios;
+    const float *cumulativeWeights;
+    int32_t numScenarios;
+    ScenarioSampling sampling;
+    uint32_t curriculumEpisodesPerStage;
+};
+
+// Host side loading, implemented in scenario_bank.cpp and exported from the
+// manager library for bball_server. The file is memory mapped and the bank
+// points straight into the mapping.
+struct MappedScenarioBank {
+    void *mapping;
+    size_t numBytes;
+    float *cumulativeWeights;
+    ScenarioBank bank;
+};
+
+MGR_EXPORT bool mapScenarioBank(const char *path,
+                                ScenarioSampling sampling,
+                                uint32_t curriculum_episodes_per_stage,
+                                MappedScenarioBank &out);
+MGR_EXPORT void unmapScenarioBank(MappedScenarioBank &mapped);
+
+}
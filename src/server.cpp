@@ -0,0 +1,588 @@
+// bball_server: one CPU Manager shared by many local trainer processes over
+// a Unix socket, see server_protocol.hpp for the wire format. Every client
+// owns a range of worlds; the server steps all worlds once each connected
+// client has sent its Step, then answers every client with the rewards and
+// dones of its range. Worlds no client owns keep running on their last
+// actions.
+//
+//   bball_server --scenarios scripts/scenarios.bin --num-worlds 8192
+//       --socket /tmp/bball_sim.sock --shm /bball_sim --episode-ticks 400
+#include "mgr.hpp"
+#include "types.hpp"
+#include "shm_export.hpp"
+#include "scenario_bank.hpp"
+#include "server_protocol.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace madrona;
+using namespace madsimple;
+
+namespace {
+
+struct ServerArgs {
+    const char *socketPath = "/tmp/bball_sim.sock";
+    const char *shmName = "/bball_sim";
+    const char *scenarioPath = nullptr;
+    const char *shotModelPath = nullptr;
+    uint32_t numWorlds = 1024;
+    uint32_t numThreads = 0;
+    uint32_t seed = 0;
+    // Worlds reset (and report done) after this many ticks, 0 leaves
+    // episode ends to the clients
+    uint32_t episodeTicks = 0;
+};
+
+// A client that stops reading its StepResult is dropped after this long
+// instead of holding up every other client
+constexpr int CLIENT_SEND_TIMEOUT_MS = 1000;
+
+struct Client {
+    int fd;
+    bool registered;
+    bool stepping; // sent Step, waiting for the others
+    uint32_t firstWorld;
+    uint32_t numWorlds;
+    std::vector<uint8_t> resets;
+
+    // Client sockets are non-blocking and messages are received piecewise
+    // as they arrive, so a client that stalls mid-message only holds up
+    // its own connection
+    ServerMessageHeader header;
+    uint64_t headerBytes; // received so far
+    std::vector<uint8_t> payload; // sized once the header is in
+    uint64_t payloadBytes; // received so far
+};
+
+volatile sig_atomic_t serverRunning = 1;
+
+void stopServer(int)
+{
+    serverRunning = 0;
+}
+
+// Waits for room in the socket buffer when it fills up, bounded by
+// CLIENT_SEND_TIMEOUT_MS per wait
+bool writeAll(int fd, const void *src, uint64_t num_bytes)
+{
+    const char *ptr = (const char *)src;
+    while (num_bytes > 0) {
+        ssize_t n = send(fd, ptr, num_bytes, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd writable {fd, POLLOUT, 0};
+            if (poll(&writable, 1, CLIENT_SEND_TIMEOUT_MS) <= 0) {
+                return false;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        num_bytes -= (uint64_t)n;
+    }
+    return true;
+}
+
+bool sendMessage(int fd, ServerMessage type, const void *payload,
+                 uint64_t num_bytes)
+{
+    ServerMessageHeader header {
+        SERVER_PROTOCOL_MAGIC, type, num_bytes,
+    };
+    return writeAll(fd, &header, sizeof(header)) &&
+        writeAll(fd, payload, num_bytes);
+}
+
+void sendError(int fd, const std::string &message)
+{
+    sendMessage(fd, ServerMessage::Error, message.data(), message.size());
+}
+
+// The server is the single external writer of the shared memory export:
+// clients fill in their worlds' actions and the server publishes them all
+// at once by bumping actionSequence
+SharedExportHeader * attachSharedHeader(const char *name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    void *mapping = mmap(nullptr, sizeof(SharedExportHeader),
+                         PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return mapping == MAP_FAILED ? nullptr : (SharedExportHeader *)mapping;
+}
+
+int listenOn(const char *path)
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    // A leftover socket file from a previous run blocks bind
+    unlink(path);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+class EnvServer {
+public:
+    EnvServer(const ServerArgs &args, Manager &mgr,
+              SharedExportHeader *shared_header)
+        : args_(args),
+          mgr_(mgr),
+          sharedHeader_(shared_header),
+          resets_((WorldReset *)mgr.resetTensor().devicePtr()),
+          scores_((const Scorecard *)mgr.gameStateTensor().devicePtr()),
+          boxScores_((const BoxScore *)mgr.boxScoreTensor().devicePtr()),
+          teamPoints_(2 * (uint64_t)args.numWorlds),
+          nextTeamPoints_(2 * (uint64_t)args.numWorlds),
+          dones_(args.numWorlds),
+          rewards_(2 * (uint64_t)args.numWorlds),
+          clients_(),
+          tick_(0)
+    {
+        readTeamPoints(teamPoints_.data());
+    }
+
+    void run(int listen_fd)
+    {
+        std::vector<pollfd> fds;
+        while (serverRunning) {
+            fds.clear();
+            fds.push_back({listen_fd, POLLIN, 0});
+            for (const Client &client : clients_) {
+                fds.push_back({client.fd, POLLIN, 0});
+            }
+
+            if (poll(fds.data(), fds.size(), 200) < 0) {
+                continue;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if (fd != -1 && !setNonBlocking(fd)) {
+                    close(fd);
+                } else if (fd != -1) {
+                    clients_.push_back({fd, false, false, 0, 0, {},
+                                        {}, 0, {}, 0});
+                }
+            }
+
+            // Clients accepted above aren't in fds yet
+            for (size_t i = 1; i < fds.size(); i++) {
+                if (fds[i].revents != 0 && !receiveMessage(clients_[i - 1])) {
+                    close(clients_[i - 1].fd);
+                    clients_[i - 1].fd = -1;
+                }
+            }
+            std::erase_if(clients_, [](const Client &c) { return c.fd == -1; });
+
+            if (allClientsStepping()) {
+                stepWorlds();
+            }
+        }
+
+        for (const Client &client : clients_) {
+            close(client.fd);
+        }
+    }
+
+private:
+    // Reads whatever the client has sent so far and handles the message
+    // once it's complete. At most one message is handled per call, the
+    // rest stays in the socket for the next poll. False drops the client.
+    bool receiveMessage(Client &client)
+    {
+        while (true) {
+            bool in_header = client.headerBytes < sizeof(ServerMessageHeader);
+            char *dst = in_header ?
+                (char *)&client.header + client.headerBytes :
+                (char *)client.payload.data() + client.payloadBytes;
+            uint64_t remaining = in_header ?
+                sizeof(ServerMessageHeader) - client.headerBytes :
+                client.payload.size() - client.payloadBytes;
+
+            if (remaining > 0) {
+                ssize_t n = recv(client.fd, dst, remaining, 0);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0) {
+                    return errno == EAGAIN || errno == EWOULDBLOCK;
+                }
+                if (n == 0) {
+                    return false;
+                }
+
+                if (in_header) {
+                    client.headerBytes += (uint64_t)n;
+                    if (client.headerBytes < sizeof(ServerMessageHeader)) {
+                        continue;
+                    }
+                    if (!beginPayload(client)) {
+                        return false;
+                    }
+                } else {
+                    client.payloadBytes += (uint64_t)n;
+                }
+            }
+
+            if (client.headerBytes == sizeof(ServerMessageHeader) &&
+                    client.payloadBytes == client.payload.size()) {
+                client.headerBytes = 0;
+                client.payloadBytes = 0;
+                return handleMessage(client);
+            }
+        }
+    }
+
+    // Checks a complete header against what the client may send next,
+    // before anything is allocated for its payload
+    bool beginPayload(Client &client)
+    {
+        const ServerMessageHeader &header = client.header;
+        if (header.magic != SERVER_PROTOCOL_MAGIC) {
+            return false;
+        }
+
+        switch (header.type) {
+        case ServerMessage::Hello: {
+            if (header.payloadBytes != sizeof(ServerHello)) {
+                return false;
+            }
+            break;
+        }
+        case ServerMessage::Step: {
+            if (!client.registered || client.stepping ||
+                    header.payloadBytes != client.numWorlds) {
+                sendError(client.fd, "Step before Hello or with a resets "
+                          "array that doesn't match the claimed worlds");
+                return false;
+            }
+            break;
+        }
+        default: {
+            sendError(client.fd, "Unexpected message type");
+            return false;
+        }
+        }
+
+        client.payload.resize(header.payloadBytes);
+        client.payloadBytes = 0;
+        return true;
+    }
+
+    bool handleMessage(Client &client)
+    {
+        switch (client.header.type) {
+        case ServerMessage::Hello: {
+            ServerHello hello;
+            memcpy(&hello, client.payload.data(), sizeof(hello));
+            return registerClient(client, hello);
+        }
+        case ServerMessage::Step: {
+            memcpy(client.resets.data(), client.payload.data(),
+                   client.numWorlds);
+            client.stepping = true;
+            return true;
+        }
+        default: {
+            return false;
+        }
+        }
+    }
+
+    bool registerClient(Client &client, const ServerHello &hello)
+    {
+        uint64_t end = (uint64_t)hello.firstWorld + hello.numWorlds;
+        std::string error;
+        if (client.registered) {
+            error = "Hello sent twice";
+        } else if (hello.version != SERVER_PROTOCOL_VERSION) {
+            error = "Protocol version mismatch";
+        } else if (hello.numWorlds == 0 || end > args_.numWorlds) {
+            error = "World range outside the server's " +
+                std::to_string(args_.numWorlds) + " worlds";
+        }
+
+        for (const Client &other : clients_) {
+            if (error.empty() && other.registered &&
+                    hello.firstWorld < other.firstWorld + other.numWorlds &&
+                    other.firstWorld < end) {
+                error = "World range overlaps another client";
+            }
+        }
+
+        if (!error.empty()) {
+            sendError(client.fd, error);
+            return false;
+        }
+
+        client.registered = true;
+        client.firstWorld = hello.firstWorld;
+        client.numWorlds = hello.numWorlds;
+        client.resets.assign(hello.numWorlds, 0);
+
+        ServerWelcome welcome {};
+        welcome.version = SERVER_PROTOCOL_VERSION;
+        welcome.numWorlds = args_.numWorlds;
+        welcome.numPlayers = ACTIVE_PLAYERS;
+        strncpy(welcome.sharedMemoryName, args_.shmName,
+                SERVER_SHM_NAME_BYTES - 1);
+        return sendMessage(client.fd, ServerMessage::Welcome, &welcome,
+                           sizeof(welcome));
+    }
+
+    bool allClientsStepping() const
+    {
+        bool any = false;
+        for (const Client &client : clients_) {
+            if (!client.registered) {
+                continue;
+            }
+            if (!client.stepping) {
+                return false;
+            }
+            any = true;
+        }
+        return any;
+    }
+
+    void readTeamPoints(int32_t *points) const
+    {
+        for (uint64_t w = 0; w < args_.numWorlds; w++) {
+            const BoxScore &box = boxScores_[w];
+            points[2 * w] = 0;
+            points[2 * w + 1] = 0;
+            for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+                points[2 * w + (i >= FIRST_TEAM2_PLAYER)] +=
+                    box.players[i].points;
+            }
+        }
+    }
+
+    void stepWorlds()
+    {
+        for (const Client &client : clients_) {
+            for (uint32_t i = 0; i < client.numWorlds; i++) {
+                if (client.resets[i] != 0) {
+                    resets_[client.firstWorld + i].reset = 1;
+                }
+            }
+        }
+
+        // Reset at the end of the step that reaches episodeTicks
+        if (args_.episodeTicks > 0) {
+            for (uint64_t w = 0; w < args_.numWorlds; w++) {
+                if (scores_[w].ticksElapsed + 1 >= (int32_t)args_.episodeTicks) {
+                    resets_[w].reset = 1;
+                }
+            }
+        }
+
+        for (uint64_t w = 0; w < args_.numWorlds; w++) {
+            dones_[w] = resets_[w].reset != 0 ? 1 : 0;
+        }
+
+        std::atomic_ref<uint64_t>(sharedHeader_->actionSequence)
+            .fetch_add(1, std::memory_order_release);
+        mgr_.step();
+        tick_ += 1;
+
+        // The box score outlives resets, so points scored on a world's
+        // last tick still count
+        readTeamPoints(nextTeamPoints_.data());
+        for (uint64_t w = 0; w < args_.numWorlds; w++) {
+            float team1 = (float)(nextTeamPoints_[2 * w] -
+                                  teamPoints_[2 * w]);
+            float team2 = (float)(nextTeamPoints_[2 * w + 1] -
+                                  teamPoints_[2 * w + 1]);
+            rewards_[2 * w] = team1 - team2;
+            rewards_[2 * w + 1] = team2 - team1;
+        }
+        teamPoints_.swap(nextTeamPoints_);
+
+        for (Client &client : clients_) {
+            if (!client.stepping) {
+                continue;
+            }
+            client.stepping = false;
+            if (!sendStepResult(client)) {
+                close(client.fd);
+                client.fd = -1;
+            }
+        }
+        std::erase_if(clients_, [](const Client &c) { return c.fd == -1; });
+    }
+
+    bool sendStepResult(const Client &client)
+    {
+        uint64_t n = client.numWorlds;
+        std::vector<char> payload(sizeof(ServerStepResult) +
+                                  n * 2 * sizeof(float) + n);
+        ServerStepResult result { tick_ };
+        memcpy(payload.data(), &result, sizeof(result));
+        memcpy(payload.data() + sizeof(result),
+               rewards_.data() + 2 * (uint64_t)client.firstWorld,
+               n * 2 * sizeof(float));
+        memcpy(payload.data() + sizeof(result) + n * 2 * sizeof(float),
+               dones_.data() + client.firstWorld, n);
+        return sendMessage(client.fd, ServerMessage::StepResult,
+                           payload.data(), payload.size());
+    }
+
+    const ServerArgs &args_;
+    Manager &mgr_;
+    SharedExportHeader *sharedHeader_;
+    WorldReset *resets_;
+    const Scorecard *scores_;
+    const BoxScore *boxScores_;
+    std::vector<int32_t> teamPoints_; // [W, 2] box score points so far
+    std::vector<int32_t> nextTeamPoints_; // scratch, swapped in every step
+    std::vector<uint8_t> dones_;
+    std::vector<float> rewards_;
+    std::vector<Client> clients_;
+    uint64_t tick_;
+};
+
+bool parseArgs(int argc, char *argv[], ServerArgs &args)
+{
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!has_value) {
+            return false;
+        }
+
+        const char *flag = argv[i];
+        const char *value = argv[++i];
+        if (!strcmp(flag, "--socket")) {
+            args.socketPath = value;
+        } else if (!strcmp(flag, "--shm")) {
+            args.shmName = value;
+        } else if (!strcmp(flag, "--scenarios")) {
+            args.scenarioPath = value;
+        } else if (!strcmp(flag, "--shot-model")) {
+            args.shotModelPath = value;
+        } else if (!strcmp(flag, "--num-worlds")) {
+            args.numWorlds = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (!strcmp(flag, "--threads")) {
+            args.numThreads = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (!strcmp(flag, "--seed")) {
+            args.seed = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (!strcmp(flag, "--episode-ticks")) {
+            args.episodeTicks = (uint32_t)strtoul(value, nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return args.scenarioPath != nullptr && args.numWorlds > 0 &&
+        strlen(args.shmName) < SERVER_SHM_NAME_BYTES;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    ServerArgs args;
+    if (!parseArgs(argc, argv, args)) {
+        fprintf(stderr, "%s --scenarios BANK [--num-worlds N] [--socket PATH] "
+                "[--shm NAME] [--threads N] [--seed S] [--episode-ticks T] "
+                "[--shot-model PATH]\n", argv[0]);
+        return 1;
+    }
+
+    // The bank's first scenario is the court every world starts from,
+    // resets sample the whole bank
+    MappedScenarioBank mapped;
+    if (!mapScenarioBank(args.scenarioPath, ScenarioSampling::Uniform, 1,
+                         mapped)) {
+        fprintf(stderr, "Failed to load scenario bank %s\n",
+                args.scenarioPath);
+        return 1;
+    }
+    std::vector<Player> players(mapped.bank.scenarios[0].players,
+        mapped.bank.scenarios[0].players + ACTIVE_PLAYERS);
+    unmapScenarioBank(mapped);
+
+    Manager mgr(Manager::Config {
+        .maxEpisodeLength = args.episodeTicks,
+        .execMode = ExecMode::CPU,
+        .numWorlds = args.numWorlds,
+        .numPlayers = ACTIVE_PLAYERS,
+        .gpuID = 0,
+        .shotModelPath = args.shotModelPath,
+        .seed = args.seed,
+        .scenarioBankPath = args.scenarioPath,
+        .sharedMemoryName = args.shmName,
+        .sharedMemoryActions = true,
+        .numThreads = args.numThreads,
+    }, CourtState {
+        .players = players.data(),
+        .numPlayers = ACTIVE_PLAYERS,
+    });
+
+    SharedExportHeader *shared_header = attachSharedHeader(args.shmName);
+    if (shared_header == nullptr) {
+        fprintf(stderr, "Failed to attach to shared memory %s\n",
+                args.shmName);
+        return 1;
+    }
+
+    int listen_fd = listenOn(args.socketPath);
+    if (listen_fd == -1) {
+        fprintf(stderr, "Failed to listen on %s\n", args.socketPath);
+        return 1;
+    }
+
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    printf("Serving %u worlds on %s, shared memory %s\n", args.numWorlds,
+           args.socketPath, args.shmName);
+    fflush(stdout);
+
+    EnvServer server(args, mgr, shared_header);
+    server.run(listen_fd);
+
+    close(listen_fd);
+    unlink(args.socketPath);
+    munmap(shared_header, sizeof(SharedExportHeader));
+    return 0;
+}
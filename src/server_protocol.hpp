@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+namespace madsimple {
+
+// Wire format of bball_server (server.cpp), a Unix socket server that hosts
+// one Manager for several trainer processes. Bulk state never goes through
+// the socket: observations are read from, and actions written to, the
+// simulator's shared memory export (shm_export.hpp), the socket only
+// carries the step barrier, resets, rewards and dones.
+//
+// Every message is a ServerMessageHeader followed by payloadBytes bytes,
+// little endian, no padding between arrays. A session is
+//   client Hello -> server Welcome (or Error, then the server hangs up)
+//   client writes actions / choices for its worlds into shared memory
+//   client Step -> server StepResult once every client has sent its Step
+// Python's client is in remote.py.
+constexpr uint32_t SERVER_PROTOCOL_MAGIC = 0x53565342; // "BSVS"
+constexpr uint32_t SERVER_PROTOCOL_VERSION = 1;
+constexpr uint32_t SERVER_SHM_NAME_BYTES = 64;
+
+enum class ServerMessage : uint32_t {
+    // ServerHello
+    Hello = 1,
+    // ServerWelcome
+    Welcome = 2,
+    // uint8_t resets[numWorlds] for the client's worlds, nonzero starts a
+    // new episode at the end of this step
+    Step = 3,
+    // ServerStepResult, float rewards[numWorlds][2] (team 1, team 2),
+    // uint8_t dones[numWorlds]
+    StepResult = 4,
+    // Error text, the connection is closed after it
+    Error = 5,
+};
+
+struct ServerMessageHeader {
+    uint32_t magic;
+    ServerMessage type;
+    uint64_t payloadBytes;
+};
+
+// Claims worlds [firstWorld, firstWorld + numWorlds), ranges of connected
+// clients may not overlap
+struct ServerHello {
+    uint32_t version;
+    uint32_t firstWorld;
+    uint32_t numWorlds;
+    uint32_t reserved;
+};
+
+struct ServerWelcome {
+    uint32_t version;
+    uint32_t numWorlds; // hosted by the server, not just the client's
+    uint32_t numPlayers;
+    uint32_t reserved;
+    char sharedMemoryName[SERVER_SHM_NAME_BYTES];
+};
+
+struct ServerStepResult {
+    uint64_t tick; // steps run by the server so far
+};
+
+static_assert(sizeof(ServerMessageHeader) == 16);
+static_assert(sizeof(ServerWelcome) == 80);
+
+}
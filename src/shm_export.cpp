@@ -0,0 +1,190 @@
+#include "shm_export.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include <cerrno>
+#include <csignal>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace madsimple {
+
+static inline uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + SHARED_EXPORT_ALIGNMENT - 1) &
+        ~(SHARED_EXPORT_ALIGNMENT - 1);
+}
+
+// Unlinks name if it is an export left behind by a simulator that has
+// exited (e.g. crashed before its destructor ran). Anything else, a live
+// simulator's export or an object this code didn't create, is left alone.
+static bool unlinkIfStale(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return false;
+    }
+
+    bool stale = false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 &&
+            (uint64_t)st.st_size >= sizeof(SharedExportHeader)) {
+        void *mapping = mmap(nullptr, sizeof(SharedExportHeader), PROT_READ,
+                             MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+            auto *header = (const SharedExportHeader *)mapping;
+            stale = header->magic == SHARED_EXPORT_MAGIC &&
+                header->version == SHARED_EXPORT_VERSION &&
+                header->ownerPid != 0 &&
+                kill((pid_t)header->ownerPid, 0) == -1 && errno == ESRCH;
+            munmap(mapping, sizeof(SharedExportHeader));
+        }
+    }
+    close(fd);
+
+    if (stale) {
+        shm_unlink(name);
+    }
+    return stale;
+}
+
+SharedExport * SharedExport::create(const char *name,
+                                    uint32_t num_worlds,
+                                    const Buffer *buffers,
+                                    uint32_t num_buffers)
+{
+    if (num_buffers > SHARED_EXPORT_MAX_BUFFERS) {
+        return nullptr;
+    }
+
+    uint64_t offsets[SHARED_EXPORT_MAX_BUFFERS];
+    uint64_t num_bytes = alignOffset(sizeof(SharedExportHeader));
+    for (uint32_t i = 0; i < num_buffers; i++) {
+        offsets[i] = num_bytes;
+        num_bytes = alignOffset(num_bytes + buffers[i].numBytes);
+    }
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1 && errno == EEXIST && unlinkIfStale(name)) {
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    if (ftruncate(fd, (off_t)num_bytes) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return nullptr;
+    }
+
+    void *mapping = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name);
+        return nullptr;
+    }
+
+    auto *header = (SharedExportHeader *)mapping;
+    memset(header, 0, sizeof(SharedExportHeader));
+    header->magic = SHARED_EXPORT_MAGIC;
+    header->version = SHARED_EXPORT_VERSION;
+    header->numWorlds = num_worlds;
+    header->numBuffers = num_buffers;
+    header->ownerPid = (uint32_t)getpid();
+
+    for (uint32_t i = 0; i < num_buffers; i++) {
+        SharedBufferDesc &desc = header->buffers[i];
+        strncpy(desc.name, buffers[i].name, sizeof(desc.name) - 1);
+        memcpy(desc.dtype, buffers[i].dtype, sizeof(desc.dtype));
+        desc.numDims = buffers[i].numDims;
+        memcpy(desc.dims, buffers[i].dims, sizeof(desc.dims));
+        desc.offset = offsets[i];
+        desc.numBytes = buffers[i].numBytes;
+    }
+
+    // Writable buffers are never published, start them from the
+    // simulator's values so a writer that only fills some of them (or the
+    // first pullActions) doesn't load zeros, e.g. freezing every world
+    for (uint32_t i = 0; i < num_buffers; i++) {
+        if (buffers[i].writable) {
+            memcpy((char *)mapping + offsets[i], buffers[i].simPtr,
+                   buffers[i].numBytes);
+        }
+    }
+
+    return new SharedExport(strdup(name), mapping, num_bytes,
+                            buffers, num_buffers);
+}
+
+SharedExport::SharedExport(char *name, void *mapping, uint64_t num_bytes,
+                           const Buffer *buffers, uint32_t num_buffers)
+    : name_(name),
+      mapping_(mapping),
+      numBytes_(num_bytes),
+      numBuffers_(num_buffers)
+{
+    memcpy(buffers_, buffers, sizeof(Buffer) * num_buffers);
+}
+
+SharedExport::~SharedExport()
+{
+    munmap(mapping_, numBytes_);
+    shm_unlink(name_);
+    free(name_);
+}
+
+void SharedExport::pullActions()
+{
+    auto *header = (SharedExportHeader *)mapping_;
+
+    uint64_t action_seq = std::atomic_ref<uint64_t>(header->actionSequence)
+        .load(std::memory_order_acquire);
+    if (action_seq == header->consumedActionSequence) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < numBuffers_; i++) {
+        if (!buffers_[i].writable) {
+            continue;
+        }
+
+        memcpy(buffers_[i].simPtr,
+               (char *)mapping_ + header->buffers[i].offset,
+               buffers_[i].numBytes);
+    }
+
+    std::atomic_ref<uint64_t>(header->consumedActionSequence)
+        .store(action_seq, std::memory_order_release);
+}
+
+void SharedExport::publish()
+{
+    auto *header = (SharedExportHeader *)mapping_;
+    std::atomic_ref<uint64_t> seq(header->sequence);
+
+    uint64_t start = seq.load(std::memory_order_relaxed);
+    seq.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Writable buffers belong to the external writer, copying them out
+    // could clobber actions it is in the middle of writing
+    for (uint32_t i = 0; i < numBuffers_; i++) {
+        if (buffers_[i].writable) {
+            continue;
+        }
+
+        memcpy((char *)mapping_ + header->buffers[i].offset,
+               buffers_[i].simPtr, buffers_[i].numBytes);
+    }
+
+    seq.store(start + 2, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace madsimple {
+
+// Mirrors exported simulator tensors into a named POSIX shared memory object
+// so other local processes (viewers, loggers, trainers) can attach to a
+// running simulator. State is published after every step under a seqlock,
+// and buffers marked writable (actions) are pulled back in before a step
+// whenever an external writer bumps actionSequence.
+//
+// Layout: SharedExportHeader at offset 0, then each buffer at its offset,
+// aligned to SHARED_EXPORT_ALIGNMENT. Python's view is in shared.py.
+constexpr uint32_t SHARED_EXPORT_MAGIC = 0x4d485342; // "BSHM"
+constexpr uint32_t SHARED_EXPORT_VERSION = 2;
+constexpr uint32_t SHARED_EXPORT_MAX_BUFFERS = 16;
+constexpr uint32_t SHARED_EXPORT_MAX_DIMS = 4;
+constexpr uint64_t SHARED_EXPORT_ALIGNMENT = 64;
+
+struct SharedBufferDesc {
+    char name[32];
+    char dtype[4]; // numpy style, e.g. "<f4"
+    uint32_t numDims;
+    int64_t dims[SHARED_EXPORT_MAX_DIMS];
+    uint64_t offset;
+    uint64_t numBytes;
+};
+
+struct SharedExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    // Odd while the simulator is copying state in, readers retry until they
+    // see the same even value before and after their copy
+    uint64_t sequence;
+    // Bumped by the external writer after filling the writable buffers
+    uint64_t actionSequence;
+    // Last actionSequence the simulator copied in
+    uint64_t consumedActionSequence;
+    uint32_t numWorlds;
+    uint32_t numBuffers;
+    // Process that created the object. Only an object whose owner has
+    // exited may be replaced by a new simulator with the same name.
+    uint32_t ownerPid;
+    uint32_t reserved;
+    SharedBufferDesc buffers[SHARED_EXPORT_MAX_BUFFERS];
+};
+
+static_assert(sizeof(SharedBufferDesc) == 88);
+
+class SharedExport {
+public:
+    struct Buffer {
+        const char *name;
+        const char *dtype;
+        void *simPtr;
+        uint32_t numDims;
+        int64_t dims[SHARED_EXPORT_MAX_DIMS];
+        uint64_t numBytes;
+        bool writable;
+    };
+
+    // Returns nullptr if the shared memory object can't be created,
+    // including when a running simulator already exports under name
+    static SharedExport * create(const char *name,
+                                 uint32_t num_worlds,
+                                 const Buffer *buffers,
+                                 uint32_t num_buffers);
+    ~SharedExport();
+
+    // Copies writable buffers into the simulator if there are new actions
+    void pullActions();
+    // Copies the read-only buffers out to shared memory under the seqlock
+    void publish();
+
+private:
+    SharedExport(char *name, void *mapping, uint64_t num_bytes,
+                 const Buffer *buffers, uint32_t num_buffers);
+
+    char *name_;
+    void *mapping_;
+    uint64_t numBytes_;
+    Buffer buffers_[SHARED_EXPORT_MAX_BUFFERS];
+    uint32_t numBuffers_;
+};
+
+}
@@ -0,0 +1,108 @@
+#include "shot_model.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace madsimple {
+
+namespace {
+
+constexpr uint32_t SHOT_MODEL_MAGIC = 0x544f4853; // "SHOT"
+constexpr uint32_t SHOT_MODEL_VERSION = 1;
+
+struct ShotModelFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t numDistanceBins;
+    int32_t numDefenderBins;
+    int32_t numFacingBins;
+    int32_t numSpeedBins;
+};
+
+float binValue(int32_t bin, int32_t num_bins, float min_value, float max_value)
+{
+    return min_value +
+        (max_value - min_value) * (float)bin / (float)(num_bins - 1);
+}
+
+}
+
+// Default tables reproduce the original piecewise model in probabilityOfShot
+void buildDefaultShotModel(ShotModel &model)
+{
+    model.maxDistance = 50.0f;
+    model.maxDefenderDistance = 12.0f;
+    model.maxSpeed = 30.0f;
+    model.leagueThreePointPct = DEFAULT_THREE_POINT_PCT;
+    model.leagueFieldGoalPct = DEFAULT_FIELD_GOAL_PCT;
+    model.leagueRunningSpeedMph = DEFAULT_RUNNING_SPEED_MPH;
+
+    for (int32_t i = 0; i < ShotModel::NUM_DISTANCE_BINS; i++) {
+        float d = binValue(i, ShotModel::NUM_DISTANCE_BINS,
+                           0.0f, model.maxDistance);
+        model.distance[i] =
+            100.0f * std::max(0.0f, std::min(1.0f, 1.0f - d / 50.0f));
+    }
+
+    for (int32_t i = 0; i < ShotModel::NUM_DEFENDER_BINS; i++) {
+        float d = binValue(i, ShotModel::NUM_DEFENDER_BINS,
+                           0.0f, model.maxDefenderDistance);
+        model.defender[i] = 0.2f + 0.8f * (d / 12.0f);
+    }
+
+    for (int32_t i = 0; i < ShotModel::NUM_FACING_BINS; i++) {
+        float c = binValue(i, ShotModel::NUM_FACING_BINS, -1.0f, 1.0f);
+        model.facing[i] = 1.0f - std::acos(c) / (float)PI;
+    }
+
+    for (int32_t i = 0; i < ShotModel::NUM_SPEED_BINS; i++) {
+        float v = binValue(i, ShotModel::NUM_SPEED_BINS,
+                           0.0f, model.maxSpeed);
+        model.speed[i] = 1.0f - 0.25f * (v / 30.0f);
+    }
+}
+
+bool loadShotModel(const char *path, ShotModel &model)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    ShotModelFileHeader header;
+    file.read((char *)&header, sizeof(header));
+    if (!file || header.magic != SHOT_MODEL_MAGIC ||
+            header.version != SHOT_MODEL_VERSION ||
+            header.numDistanceBins != ShotModel::NUM_DISTANCE_BINS ||
+            header.numDefenderBins != ShotModel::NUM_DEFENDER_BINS ||
+            header.numFacingBins != ShotModel::NUM_FACING_BINS ||
+            header.numSpeedBins != ShotModel::NUM_SPEED_BINS) {
+        return false;
+    }
+
+    file.read((char *)&model, sizeof(ShotModel));
+    return (bool)file;
+}
+
+bool saveShotModel(const char *path, const ShotModel &model)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    ShotModelFileHeader header {
+        SHOT_MODEL_MAGIC,
+        SHOT_MODEL_VERSION,
+        ShotModel::NUM_DISTANCE_BINS,
+        ShotModel::NUM_DEFENDER_BINS,
+        ShotModel::NUM_FACING_BINS,
+        ShotModel::NUM_SPEED_BINS,
+    };
+
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)&model, sizeof(ShotModel));
+    return (bool)file;
+}
+
+}
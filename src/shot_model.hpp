@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+#include "consts.hpp"
+
+namespace madsimple {
+
+// Precomputed shot make probability. The old analytic model was a product of
+// independent factors, so each factor is tabulated over its own input and a
+// shot costs four interpolated lookups instead of two atan2s and an angle wrap.
+// Tables are built once on the host (or loaded from a tuning file) and shared
+// read-only by every world.
+struct ShotModel {
+    static constexpr int32_t NUM_DISTANCE_BINS = 128;
+    static constexpr int32_t NUM_DEFENDER_BINS = 64;
+    static constexpr int32_t NUM_FACING_BINS = 256;
+    static constexpr int32_t NUM_SPEED_BINS = 64;
+
+    // Upper end of each table's domain, inputs past it clamp to the last bin
+    float maxDistance;
+    float maxDefenderDistance;
+    float maxSpeed;
+
+    // Attribute baselines: a player at these percentages gets the raw table
+    // value, better shooters are scaled up and worse ones down
+    float leagueThreePointPct;
+    float leagueFieldGoalPct;
+    float leagueRunningSpeedMph;
+
+    // Base probability (0 - 100) by distance from the hoop
+    float distance[NUM_DISTANCE_BINS];
+    // Multiplier by distance to the closest defender
+    float defender[NUM_DEFENDER_BINS];
+    // Multiplier indexed by cos(facing delta) over [-1, 1], avoids the atan2s
+    float facing[NUM_FACING_BINS];
+    // Multiplier by player speed, normalized to the league running speed
+    float speed[NUM_SPEED_BINS];
+};
+
+// Host side construction, implemented in shot_model.cpp
+void buildDefaultShotModel(ShotModel &model);
+bool loadShotModel(const char *path, ShotModel &model);
+bool saveShotModel(const char *path, const ShotModel &model);
+
+inline float sampleShotTable(const float *table, int32_t num_bins,
+                             float value, float min_value, float max_value)
+{
+    float t = (value - min_value) / (max_value - min_value);
+    t = std::fmin(std::fmax(t, 0.0f), 1.0f) * (float)(num_bins - 1);
+
+    int32_t lo = (int32_t)t;
+    int32_t hi = lo + 1 < num_bins ? lo + 1 : lo;
+    float frac = t - (float)lo;
+
+    return table[lo] + (table[hi] - table[lo]) * frac;
+}
+
+inline float lookupShotProbability(const ShotModel &model,
+                                   float distance_from_basket,
+                                   float nearest_defender_dist,
+                                   float cos_facing_delta,
+                                   float speed)
+{
+    float probability = sampleShotTable(model.distance,
+        ShotModel::NUM_DISTANCE_BINS, distance_from_basket,
+        0.0f, model.maxDistance);
+    probability *= sampleShotTable(model.defender,
+        ShotModel::NUM_DEFENDER_BINS, nearest_defender_dist,
+        0.0f, model.maxDefenderDistance);
+    probability *= sampleShotTable(model.facing,
+        ShotModel::NUM_FACING_BINS, cos_facing_delta, -1.0f, 1.0f);
+    probability *= sampleShotTable(model.speed,
+        ShotModel::NUM_SPEED_BINS, speed, 0.0f, model.maxSpeed);
+
+    return probability;
+}
+
+}
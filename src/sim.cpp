@@ -1,7 +1,10 @@
 #include "sim.hpp"
 #include "helpers.hpp"
 #include <madrona/mw_gpu_entry.hpp>
+#include <algorithm>
+#include <cstring>
 #include <random>
+#include <utility>
 #include <cmath>
 #include <iostream>
 
@@ -11,31 +14,48 @@ using namespace madrona::math;
 
 namespace madsimple {
 
-void Sim::registerTypes(ECSRegistry &registry, const Config &)
+void Sim::registerTypes(ECSRegistry &registry, const Config &cfg)
 {
     base::registerTypes(registry);
 
     registry.registerComponent<Action>();
     registry.registerComponent<CourtPos>();
     registry.registerComponent<StaticPlayerAttributes>();
-    registry.registerComponent<BallState>();
-    registry.registerComponent<BallStatus>();
-    registry.registerComponent<BallReference>();
     registry.registerComponent<PlayerID>();
     registry.registerComponent<AgentList>();
     registry.registerComponent<PlayerStatus>();
     registry.registerComponent<PlayerDecision>();
     registry.registerComponent<FoulID>();
-    registry.registerComponent<Scorecard>();
+    registry.registerComponent<MacroCommand>();
+    registry.registerComponent<MacroParams>();
+    registry.registerComponent<CourtZone>();
 
-    registry.registerArchetype<BallArchetype>();
     registry.registerArchetype<Agent>();
-    registry.registerArchetype<GameState>();
 
-    registry.registerSingleton<BallReference>();
+    // The ball and the scoreboard are one per world, so they live as
+    // singletons rather than as single-row archetypes with a reference
+    registry.registerSingleton<BallState>();
+    registry.registerSingleton<BallStatus>();
+    registry.registerSingleton<Scorecard>();
     registry.registerSingleton<AgentList>();
-    registry.registerSingleton<GameReference>();
     registry.registerSingleton<WorldReset>();
+    registry.registerSingleton<ScenarioSelection>();
+    registry.registerSingleton<GameEventLog>();
+    registry.registerSingleton<BoxScore>();
+    registry.registerSingleton<StateHash>();
+    registry.registerSingleton<SubstepSchedule>();
+    registry.registerSingleton<SubstepStats>();
+    registry.registerSingleton<WorldActive>();
+    registry.registerSingleton<TeamPolicies>();
+    registry.registerSingleton<PairwiseGeometry>();
+
+    // Optional exports only take space in every world when enabled
+    if (cfg.observationPrecision != ObservationPrecision::Float32) {
+        registry.registerSingleton<QuantizedState>();
+    }
+    if (cfg.observationHistory) {
+        registry.registerSingleton<ObservationHistory>();
+    }
 
     // registry.registerArchetype<PlayerAgent>();
 
@@ -45,16 +65,146 @@ void Sim::registerTypes(ECSRegistry &registry, const Config &)
     registry.exportColumn<Agent, PlayerDecision>((uint32_t)ExportID::Choice);
     registry.exportColumn<Agent, FoulID>((uint32_t)ExportID::CalledFoul);
     registry.exportColumn<Agent, StaticPlayerAttributes>((uint32_t)ExportID::StaticPlayerAttributes);
+    registry.exportColumn<Agent, MacroCommand>((uint32_t)ExportID::MacroCommand);
+    registry.exportColumn<Agent, MacroParams>((uint32_t)ExportID::MacroParams);
+    registry.exportColumn<Agent, CourtZone>((uint32_t)ExportID::CourtZone);
 
-    registry.exportColumn<GameState, Scorecard>((uint32_t)ExportID::Scorecard);
-
-    registry.exportColumn<BallArchetype, BallState>((uint32_t)ExportID::BallLoc);
-    registry.exportColumn<BallArchetype, BallStatus>((uint32_t)ExportID::WhoHolds);
+    registry.exportSingleton<Scorecard>((uint32_t)ExportID::Scorecard);
+    registry.exportSingleton<BallState>((uint32_t)ExportID::BallLoc);
+    registry.exportSingleton<BallStatus>((uint32_t)ExportID::WhoHolds);
 
     registry.exportSingleton<WorldReset>((uint32_t)ExportID::Reset);
+    registry.exportSingleton<ScenarioSelection>((uint32_t)ExportID::ScenarioSelection);
+    registry.exportSingleton<GameEventLog>((uint32_t)ExportID::Events);
+    registry.exportSingleton<BoxScore>((uint32_t)ExportID::BoxScore);
+    registry.exportSingleton<StateHash>((uint32_t)ExportID::StateHash);
+    registry.exportSingleton<SubstepStats>((uint32_t)ExportID::SubstepStats);
+    registry.exportSingleton<WorldActive>((uint32_t)ExportID::WorldActive);
+    registry.exportSingleton<TeamPolicies>((uint32_t)ExportID::PolicyID);
+    registry.exportSingleton<PairwiseGeometry>(
+        (uint32_t)ExportID::PairwiseGeometry);
+
+    if (cfg.observationPrecision != ObservationPrecision::Float32) {
+        registry.exportSingleton<QuantizedState>(
+            (uint32_t)ExportID::QuantizedState);
+    }
+    if (cfg.observationHistory) {
+        registry.exportSingleton<ObservationHistory>(
+            (uint32_t)ExportID::ObservationHistory);
+    }
 
 }
 
+// Inactive worlds are frozen, every task returns before touching them and
+// a pending reset waits until the world is active again
+static inline bool isWorldActive(Engine &ctx)
+{
+    return ctx.singleton<WorldActive>().active != 0;
+}
+
+// Steers towards (x, y), easing off so it stops on the point, and turns to
+// face look_th. Returns whether the player is already there.
+static inline bool steerTowards(Action &action, const CourtPos &pos,
+                                float x, float y, float speed, float look_th)
+{
+    float dx = x - pos.x;
+    float dy = y - pos.y;
+    float dist = std::sqrt(dx * dx + dy * dy);
+    bool arrived = dist < MACRO_ARRIVE_RADIUS;
+
+    action.vdes = arrived ? 0 : std::min(speed, dist / (float)D_T);
+    action.thdes = arrived ? pos.th : atan2(dy, dx);
+    action.omdes = MACRO_TURN_GAIN * wrapAngle(look_th - pos.facing);
+    return arrived;
+}
+
+// Turns a player's MacroCommand into this tick's Action and PlayerDecision.
+// Only writes the player's own rows, other players and the ball are read.
+inline void runMacroController(Engine &ctx,
+                               Action &action,
+                               CourtPos &court_pos,
+                               PlayerID &id,
+                               PlayerDecision &decision,
+                               MacroCommand &command,
+                               MacroParams &params)
+{
+    if (!isWorldActive(ctx) || command.type == MacroType::NONE) {
+        return;
+    }
+
+    decision = PlayerDecision::MOVE;
+    if (command.status != MacroStatus::RUNNING) {
+        // Hold still until the policy sends the next command
+        action.vdes = 0;
+        action.omdes = 0;
+        return;
+    }
+
+    const BallStatus &ball = ctx.singleton<BallStatus>();
+    bool has_ball = ball.heldBy == id.id;
+    float hoop_x = (id.id >= FIRST_TEAM2_PLAYER) ? RIGHT_HOOP_X : LEFT_HOOP_X;
+    float hoop_th = atan2((float)LEFT_HOOP_Y - court_pos.y, hoop_x - court_pos.x);
+
+    switch (command.type) {
+        case MacroType::MOVE_TO: {
+            float move_th = atan2(params.y - court_pos.y, params.x - court_pos.x);
+            if (steerTowards(action, court_pos, params.x, params.y,
+                             params.speed, move_th)) {
+                command.status = MacroStatus::DONE;
+            }
+        } break;
+        case MacroType::PASS_TO: {
+            if (!has_ball || command.target < 0 ||
+                    command.target >= ACTIVE_PLAYERS || command.target == id.id) {
+                command.status = MacroStatus::FAILED;
+                break;
+            }
+
+            const CourtPos &receiver = ctx.get<CourtPos>(
+                ctx.singleton<AgentList>().e[command.target]);
+            float pass_speed = params.speed > 0 ? params.speed : MACRO_DEFAULT_PASS_SPEED;
+            action.vdes = 0;
+            action.pass_th = leadPassAngle(court_pos, receiver, pass_speed);
+            action.pass_v = pass_speed;
+            decision = PlayerDecision::PASS;
+            command.status = MacroStatus::DONE;
+        } break;
+        case MacroType::SHOOT: {
+            if (!has_ball) {
+                command.status = MacroStatus::FAILED;
+                break;
+            }
+            decision = PlayerDecision::SHOOT;
+            command.status = MacroStatus::DONE;
+        } break;
+        case MacroType::SHOOT_WHEN_OPEN: {
+            if (!has_ball) {
+                command.status = MacroStatus::FAILED;
+                break;
+            }
+
+            steerTowards(action, court_pos, params.x, params.y, params.speed, hoop_th);
+
+            const AgentList &agents = ctx.singleton<AgentList>();
+            int first_defender = (id.id >= FIRST_TEAM2_PLAYER) ? 0 : FIRST_TEAM2_PLAYER;
+            float open_sq = params.openDistance * params.openDistance;
+            bool open = true;
+            for (int i = first_defender; i < first_defender + FIRST_TEAM2_PLAYER; i++) {
+                const CourtPos &defender = ctx.get<CourtPos>(agents.e[i]);
+                float dx = defender.x - court_pos.x;
+                float dy = defender.y - court_pos.y;
+                open = open && (dx * dx + dy * dy >= open_sq);
+            }
+
+            if (open) {
+                decision = PlayerDecision::SHOOT;
+                command.status = MacroStatus::DONE;
+            }
+        } break;
+        default: break;
+    }
+}
+
 inline void takePlayerAction(Engine &ctx,
                 Action &action,
                  CourtPos &court_pos,
@@ -65,13 +215,11 @@ inline void takePlayerAction(Engine &ctx,
                 //  
                 
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
 
     foul = FoulID::NO_CALL; // reset foul state
-    if (canBallBeCaught(ctx, id)) {
-        if (catchBallIfClose(ctx, court_pos, id, status)) {
-            return;
-        }
-    }
     status.justShot = false;
     if (isHoldingBall(id, ctx)){
         status.hasBall = true;
@@ -84,8 +232,16 @@ inline void takePlayerAction(Engine &ctx,
                 status.hasBall = false;
                 status.justShot = true;
 
-                BallStatus* ball_status = &ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall);
+                BallStatus* ball_status = &ctx.singleton<BallStatus>();
                 ball_status->ballState = BallStatesPossibilities::BALL_IN_SHOT;
+
+                // Decided once at release, the make and the box score's
+                // attempts both use this value
+                float hoop_x = (id.id >= FIRST_TEAM2_PLAYER) ? RIGHT_HOOP_X : LEFT_HOOP_X;
+                int32_t shot_value =
+                    isThreePointer(court_pos.x, court_pos.y, hoop_x) ? 3 : 2;
+                status.pointsOnMake = shot_value;
+                emitGameEvent(ctx, GameEventType::SHOT, id.id, shot_value);
             }
             break;
         } 
@@ -95,6 +251,7 @@ inline void takePlayerAction(Engine &ctx,
                 status.justShot = false;
 
                 changeBallToInPass(ctx, action.pass_th, action.pass_v, status, id);
+                emitGameEvent(ctx, GameEventType::PASS, id.id, 0);
             }
             break;
         }
@@ -112,16 +269,125 @@ inline void takePlayerAction(Engine &ctx,
     }
 }
 
+// Bounds how far each pair can close this tick. Speed only moves towards
+// the (clamped) desired speed, so the larger of the two bounds it.
+inline void planSubsteps(Engine &ctx, SubstepSchedule &schedule)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    SubstepStats &stats = ctx.singleton<SubstepStats>();
+
+    int32_t num_substeps = COLLISION_CHECK_STEPS;
+    if (ctx.data().adaptiveSubsteps) {
+        const AgentList &agents = ctx.singleton<AgentList>();
+        float x[ACTIVE_PLAYERS], y[ACTIVE_PLAYERS], max_move[ACTIVE_PLAYERS];
+        for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+            const CourtPos &pos = ctx.get<CourtPos>(agents.e[i]);
+            float vdes = std::min(std::abs(ctx.get<Action>(agents.e[i]).vdes),
+                                  MAX_PLAYER_SPEED);
+            x[i] = pos.x;
+            y[i] = pos.y;
+            max_move[i] = std::max(std::abs(pos.v), vdes) * D_T;
+        }
+
+        float max_closing = 0;
+        for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+            for (int j = i + 1; j < ACTIVE_PLAYERS; j++) {
+                float closing = max_move[i] + max_move[j];
+                float dx = x[i] - x[j];
+                float dy = y[i] - y[j];
+                float reach = PLAYER_COLLISION_DISTANCE + closing;
+                if (dx * dx + dy * dy <= reach * reach) {
+                    max_closing = std::max(max_closing, closing);
+                }
+            }
+        }
+
+        num_substeps = std::clamp(
+            (int32_t)std::ceil(max_closing / SUBSTEP_MAX_CLOSING),
+            1, COLLISION_CHECK_STEPS);
+    }
+
+    schedule.numSubsteps = num_substeps;
+    stats.ticks += 1;
+    stats.substeps += num_substeps;
+}
+
+// The task graph always has COLLISION_CHECK_STEPS substeps, ones past this
+// world's schedule return straight away
+template <int32_t substep>
 inline void movePlayerStep(Engine &ctx,
                      Action &action,
                      CourtPos &court_pos)
 {
-    action.vdes = std::min(action.vdes, (float)30.0);
-    court_pos = updateCourtPositionStepped(court_pos, action);
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    int32_t num_substeps = ctx.singleton<SubstepSchedule>().numSubsteps;
+    if (substep >= num_substeps) {
+        return;
+    }
+
+    action.vdes = std::min(action.vdes, MAX_PLAYER_SPEED);
+    court_pos = updateCourtPositionStepped(court_pos, action, D_T / num_substeps);
     
 }
 
+inline void updatePairwiseGeometry(Engine &ctx, PairwiseGeometry &geometry,
+                                   bool end_of_step)
+{
+    CourtPos players[ACTIVE_PLAYERS];
+    auto agents = ctx.singleton<AgentList>().e;
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        players[i] = ctx.get<CourtPos>(agents[i]);
+    }
+    fillPairwiseGeometry(players, ctx.singleton<BallState>(), end_of_step,
+                         geometry);
+}
+
+// End of step pass, the exported state including closing speeds and ball
+// distances
+inline void computePairwiseGeometry(Engine &ctx, PairwiseGeometry &geometry)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    updatePairwiseGeometry(ctx, geometry, true);
+}
+
+inline void updateCourtZone(Engine &ctx,
+                            const CourtPos &court_pos,
+                            CourtZone &zone)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    const CourtZoneGrid &grid = *ctx.data().courtZones;
+    zone.zone = lookupCourtZone(grid, court_pos.x, court_pos.y);
+    zone.nearestInbound = lookupClosestInbound(grid, court_pos.x, court_pos.y);
+}
+
+template <int32_t substep>
+inline void substepPairwiseGeometry(Engine &ctx, PairwiseGeometry &geometry)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    if (substep >= ctx.singleton<SubstepSchedule>().numSubsteps) {
+        return;
+    }
 
+    // Only the distances the substep's rule checks read
+    updatePairwiseGeometry(ctx, geometry, false);
+}
+
+template <int32_t substep>
 inline void checkForBlockCharge(Engine &ctx,
                  Action &action,
                  CourtPos &court_pos,
@@ -130,82 +396,96 @@ inline void checkForBlockCharge(Engine &ctx,
                  PlayerDecision &decision,
                  FoulID &foul)
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    int32_t num_substeps = ctx.singleton<SubstepSchedule>().numSubsteps;
+    if (substep >= num_substeps) {
+        return;
+    }
+    float stepdt = D_T / num_substeps;
+
+    FoulID prev_foul = foul;
     auto players = ctx.singleton<AgentList>().e;
+    // Distances are from right after this substep's moves, before any
+    // player reverted, so every player sees the same contacts
+    const PairwiseGeometry &geometry = ctx.singleton<PairwiseGeometry>();
     for (int i = 0; i < ACTIVE_PLAYERS; i++){
         if (i == id.id){
             continue;
         }
         Entity p = players[i];
 
-        float distance = std::sqrt(std::pow(
-            court_pos.x - ctx.get<CourtPos>(p).x, 2) + std::pow(court_pos.y - ctx.get<CourtPos>(p).y, 2
-            ));
-
-         if (distance <= 1.5){ // If they collided, check
+         if (geometry.distance[id.id][i] <= PLAYER_COLLISION_DISTANCE){ // If they collided, check
             if ((i / FIRST_TEAM2_PLAYER) == (id.id / FIRST_TEAM2_PLAYER)){ // if same team
-                court_pos = cancelPrevMovementStep(court_pos, action); // revert the move
+                court_pos = cancelPrevMovementStep(court_pos, action, stepdt); // revert the move
             } else {
-                int whoHasBall = ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall).heldBy;
+                int whoHasBall = ctx.singleton<BallStatus>().heldBy;
                 if (whoHasBall == -1){
-                    whoHasBall = ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall).whoPassed;
+                    whoHasBall = ctx.singleton<BallStatus>().whoPassed;
                 }
                 if (whoHasBall == -1){
-                    whoHasBall = ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall).whoShot;
+                    whoHasBall = ctx.singleton<BallStatus>().whoShot;
                 }
 
-                float v1_x = -1 * court_pos.v * cos(court_pos.th);
-                float v1_y = -1 * court_pos.v * sin(court_pos.th);
-                float v2_x = ctx.get<CourtPos>(p).v * cos(ctx.get<CourtPos>(p).th);
-                float v2_y = ctx.get<CourtPos>(p).v * sin(ctx.get<CourtPos>(p).th);
-            
-                
-                float impact_factor = sqrt(pow(v1_x + v2_x, 2) + pow(v1_y + v2_y, 2));
-
-                if ((ctx.get<CourtPos>(p).v < 0.5) && (court_pos.v < 0.5)){ // if both players arent really moving
-                    // do nothing
-                } else if (((id.id / FIRST_TEAM2_PLAYER) == (whoHasBall / FIRST_TEAM2_PLAYER))
-                    && (id.id != whoHasBall)){ // If we are off ball on offense
-                    if ((impact_factor >= 1.0) && (court_pos.v >= 0.5)){ // and we run into them
-                        foul = FoulID::CHARGE;
-                    }
-                } else if (id.id == whoHasBall){ // If we have the ball
-                    if (ctx.get<CourtPos>(p).v < 0.5){ // and they are not moving
-                        foul = FoulID::CHARGE;
-                    }
-                } else if (i == whoHasBall) { // If on defense, and player we collide with has the ball
-                    if ((impact_factor >= 1.0) && (court_pos.v >= 0.5)){ // if we are moving
-                        foul = FoulID::BLOCK;
-                    }
-                } else if ((id.id / FIRST_TEAM2_PLAYER) != (whoHasBall / FIRST_TEAM2_PLAYER)
-                    && (i != whoHasBall)){ // if on defense, player with we collide with doesnt have ball
-                    if (ctx.get<CourtPos>(p).v < 0.5) { // if they are not moving
-                        foul = FoulID::PUSH;
-                    }
+                FoulID call = collisionFoul(court_pos, id.id,
+                    ctx.get<CourtPos>(p), i, whoHasBall);
+                if (call != FoulID::NO_CALL) {
+                    foul = call;
                 }
                 if (foul != FoulID::NO_CALL){
-                    court_pos = cancelPrevMovementStep(court_pos, action); // revert the move
+                    court_pos = cancelPrevMovementStep(court_pos, action, stepdt); // revert the move
                 }
             }
          } 
     }
+
+    // Only the first call of the tick is an event, later substeps repeat it
+    if (prev_foul == FoulID::NO_CALL && foul != FoulID::NO_CALL) {
+        emitGameEvent(ctx, GameEventType::FOUL, id.id, (int32_t)foul);
+    }
 }
 
+// Deterministic mode runs a player system over one world's players on a
+// single thread in ID order, so ball pickups, collision reverts and event
+// slots no longer depend on how rows were split across threads
+template <auto fn>
+inline void runPlayersInOrder(Engine &ctx, AgentList &agents)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        Entity p = agents.e[i];
+        fn(ctx, ctx.get<Action>(p), ctx.get<CourtPos>(p), ctx.get<PlayerID>(p),
+           ctx.get<PlayerStatus>(p), ctx.get<PlayerDecision>(p),
+           ctx.get<FoulID>(p));
+    }
+}
 
 inline void balltick(Engine &ctx,
-                     BallState &ball_state,
-                     BallStatus &ball_held)
-                //  
+                     BallState &ball_state)
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    BallStatus &ball_held = ctx.singleton<BallStatus>();
+
     float dt = ctx.data().dt;
     auto players = ctx.singleton<AgentList>().e;
-    std::random_device rd;
-    std::mt19937 gen(rd()); // single funciton call getRandomNumber between 0 and 1 
+    WorldRNG &gen = ctx.data().rng;
     std::uniform_real_distribution<> dis(15.0, 20.0);
 
     if (ballIsHeld(ball_held)){
         Entity p = players[ball_held.heldBy];
         if (ctx.get<PlayerStatus>(p).justShot){
-            ctx.get<PlayerStatus>(p).pointsOnMake = updateShotBallState(ctx, ball_state, ball_held, ctx.get<CourtPos>(p));
+            PlayerStatus &shooter = ctx.get<PlayerStatus>(p);
+            shooter.pointsOnMake = updateShotBallState(ctx, ball_state, ball_held,
+                ctx.get<CourtPos>(p), ctx.get<StaticPlayerAttributes>(p),
+                shooter.pointsOnMake);
             ball_held.whoShot = ball_held.heldBy;
             ball_held.heldBy = -1;
         } else {
@@ -220,35 +500,46 @@ inline void balltick(Engine &ctx,
     } else {
         float hoopx = LEFT_HOOP_X;
 
+        // Collisions are swept over the whole move, so nothing is skipped
+        // however far the ball travels in one tick
         float old_ball_state_x = ball_state.x;
         float old_ball_state_y = ball_state.y;
-        ball_state.x += ball_state.v * cos(ball_state.th) * dt;
-        ball_state.y += ball_state.v * sin(ball_state.th) * dt;
+        float move_x = ball_state.v * cos(ball_state.th) * dt;
+        float move_y = ball_state.v * sin(ball_state.th) * dt;
+        ball_state.x += move_x;
+        ball_state.y += move_y;
         if (ball_held.whoShot > -1){
             bool team1 = true;
             if (ball_held.whoShot >= FIRST_TEAM2_PLAYER){
                 hoopx = RIGHT_HOOP_X;
                 team1 = false;
             }
-            if (sqrt((hoopx - ball_state.x) * (hoopx - ball_state.x) + (LEFT_HOOP_Y - ball_state.y) * (LEFT_HOOP_Y - ball_state.y))
-            <= sqrt((ball_state.x - old_ball_state_x) * (ball_state.x - old_ball_state_x) 
-            + (ball_state.y - old_ball_state_y) * (ball_state.y - old_ball_state_y))) {
+            float hoop_toi = sweptCircleTOI(old_ball_state_x - hoopx,
+                old_ball_state_y - LEFT_HOOP_Y, move_x, move_y, HOOP_CAPTURE_RADIUS);
+            if (hoop_toi >= 0) {
+                // The make or rebound happens at the rim, not past it
+                ball_state.x = old_ball_state_x + move_x * hoop_toi;
+                ball_state.y = old_ball_state_y + move_y * hoop_toi;
+
                 // did shot go in?
                 Entity p = players[ball_held.whoShot];
                 if (ctx.get<PlayerStatus>(p).pointsOnMake != 0){
+                    emitGameEvent(ctx, GameEventType::MAKE, ball_held.whoShot,
+                                  ctx.get<PlayerStatus>(p).pointsOnMake);
                     ball_state.v = 0.0;
                     ball_state.th = 0.0;
                     if (team1){
-                        ctx.get<Scorecard>(ctx.singleton<GameReference>().theGame).score1 
+                        ctx.singleton<Scorecard>().score1 
                             += ctx.get<PlayerStatus>(p).pointsOnMake;
                     } else {
-                        ctx.get<Scorecard>(ctx.singleton<GameReference>().theGame).score2 
+                        ctx.singleton<Scorecard>().score2 
                             += ctx.get<PlayerStatus>(p).pointsOnMake;
                     }
                     
                     ctx.get<PlayerStatus>(p).pointsOnMake = 0;
                 }
                 else{
+                    emitGameEvent(ctx, GameEventType::MISS, ball_held.whoShot, 0);
                     dis = std::uniform_real_distribution<>(0.0, 10.0);
                     ball_state.v = (float)dis(gen);
                     dis = std::uniform_real_distribution<>(atan(1)*-2, atan(1)*2);
@@ -264,27 +555,84 @@ inline void balltick(Engine &ctx,
                 
             }
         } else {
+            // Players moved this tick too, so sweep the ball relative to
+            // each of them and give it to whoever it reaches first. Ties go
+            // to the lower player ID. A player who can catch the pass or
+            // loose ball (canBallBeCaught) reaches out to CATCHING_WINGSPAN
+            // if shouldPlayerCatch accepts the ball at the moment of
+            // contact, otherwise it's only picked up within
+            // LOOSE_BALL_PICKUP_RADIUS.
+            int32_t catcher = -1;
+            bool hand_catch = false;
+            float first_toi = 2.0f;
             for (int i = 0; i < ACTIVE_PLAYERS; i++){
-                Entity pl = players[i];
-                CourtPos ppos = ctx.get<CourtPos>(pl);
-                float dist = sqrt((ppos.x - ball_state.x) * (ppos.x - ball_state.x) + (ppos.y - ball_state.y) * (ppos.y - ball_state.y));
-                if ((dist < 2.0) && (ctx.get<PlayerID>(pl).id != ball_held.whoPassed)) {
-                    ball_held.heldBy = i;
+                if (i == ball_held.whoPassed) {
+                    continue;
+                }
+
+                CourtPos ppos = ctx.get<CourtPos>(players[i]);
+                float player_move_x = ppos.v * cos(ppos.th) * dt;
+                float player_move_y = ppos.v * sin(ppos.th) * dt;
+                float start_x = ppos.x - player_move_x;
+                float start_y = ppos.y - player_move_y;
+                float rel_move_x = move_x - player_move_x;
+                float rel_move_y = move_y - player_move_y;
+
+                float toi = -1;
+                bool caught = false;
+                if (canBallBeCaught(ctx, ctx.get<PlayerID>(players[i]))) {
+                    toi = sweptCircleTOI(old_ball_state_x - start_x,
+                        old_ball_state_y - start_y, rel_move_x, rel_move_y,
+                        CATCHING_WINGSPAN);
+                    if (toi >= 0) {
+                        BallState contact = ball_state;
+                        contact.x = old_ball_state_x + move_x * toi;
+                        contact.y = old_ball_state_y + move_y * toi;
+                        CourtPos reach = ppos;
+                        reach.x = start_x + player_move_x * toi;
+                        reach.y = start_y + player_move_y * toi;
+                        caught = shouldPlayerCatch(&contact, reach);
+                    }
+                }
+                if (!caught) {
+                    toi = sweptCircleTOI(old_ball_state_x - start_x,
+                        old_ball_state_y - start_y, rel_move_x, rel_move_y,
+                        LOOSE_BALL_PICKUP_RADIUS);
+                }
+
+                if (toi >= 0 && toi < first_toi) {
+                    first_toi = toi;
+                    catcher = i;
+                    hand_catch = caught;
+                }
+            }
+
+            if (catcher != -1) {
+                CourtPos ppos = ctx.get<CourtPos>(players[catcher]);
+                emitPossessionEvent(ctx, catcher, ball_held.whoPassed);
+                ball_held.heldBy = catcher;
+                ball_held.whoPassed = -1;
+                ball_held.whoShot = -1; // rebounding check here?
+                ball_state.x = ppos.x;
+                ball_state.y = ppos.y;
+                if (hand_catch) {
+                    // A caught ball stops dead and keeps its flight state
+                    // until the catcher passes or shoots
+                    ctx.get<PlayerStatus>(players[catcher]).hasBall = true;
+                    ball_state.v = 0;
+                    ball_state.th = 0;
+                } else {
                     ball_held.ballState = BallStatesPossibilities::BALL_IS_HELD;
-                    ball_held.whoPassed = -1;
-                    ball_held.whoShot = -1; // rebounding check here?
-                    ball_state.x = ppos.x;
-                    ball_state.y = ppos.y;
                     ball_state.v = ppos.v;
                     ball_state.th = ppos.th;
-                    break;
                 }
             }
         }
     }
 
-    // if (ballIsOOB(ball_state) && (ball_held.ballState < 3)){
-    //     int closest_inbound_index = findClosestInbound(ball_state);
+    // const CourtZoneGrid &court_zones = *ctx.data().courtZones;
+    // if (ballIsOOB(court_zones, ball_state) && (ball_held.ballState < 3)){
+    //     int closest_inbound_index = findClosestInbound(court_zones, ball_state);
     //     ball_state.x = INBOUND_POINTS[closest_inbound_index].x;
     //     ball_state.y = INBOUND_POINTS[closest_inbound_index].y;
     //     ball_state.v = 0.0;
@@ -313,7 +661,47 @@ inline void balltick(Engine &ctx,
     // } // saving inbound code for later
 
 
-    ctx.get<Scorecard>(ctx.singleton<GameReference>().theGame).ticksElapsed += 1;
+    ctx.singleton<Scorecard>().ticksElapsed += 1;
+}
+
+// Folds this tick's events into the per player counters. Runs every step
+// so it never falls more than one tick behind the ring buffer.
+inline void accumulateBoxScore(Engine &ctx, BoxScore &box)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    const GameEventLog &log = ctx.singleton<GameEventLog>();
+    uint32_t &cursor = ctx.data().boxScoreCursor;
+
+    for (; cursor < log.numEmitted; cursor++) {
+        const GameEvent &event = log.events[cursor % EVENT_LOG_CAPACITY];
+        PlayerBoxScore &player = box.players[event.playerId];
+
+        switch (event.type) {
+            case GameEventType::SHOT: {
+                player.fieldGoalsAttempted += 1;
+                player.threesAttempted += event.data == 3 ? 1 : 0;
+            } break;
+            case GameEventType::MAKE: {
+                player.points += event.data;
+                player.fieldGoalsMade += 1;
+                player.threesMade += event.data == 3 ? 1 : 0;
+            } break;
+            case GameEventType::PASS: {
+                player.passes += 1;
+            } break;
+            case GameEventType::STEAL: {
+                player.steals += 1;
+                box.players[event.data].passesStolen += 1;
+            } break;
+            case GameEventType::FOUL: {
+                player.fouls += 1;
+            } break;
+            default: break;
+        }
+    }
 }
 
 inline void postprocess(Engine &ctx,
@@ -321,79 +709,621 @@ inline void postprocess(Engine &ctx,
                 PlayerStatus &status)
                 //  
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
     PlayerStatus st = status;
-    if (ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall).heldBy != id.id) {
+    if (ctx.singleton<BallStatus>().heldBy != id.id) {
         st.hasBall = false;
     }
     st.justShot = false;
     status = st;
 }
 
+static inline float sampleRange(WorldRNG &rng, const ValueRange &range)
+{
+    if (range.max <= range.min) {
+        return range.min;
+    }
+    return std::uniform_real_distribution<float>(range.min, range.max)(rng);
+}
+
+// A scenario index written to the exported selection wins, otherwise one is
+// drawn according to the bank's sampling mode
+static int32_t pickScenario(Engine &ctx, const ScenarioBank &bank)
+{
+    ScenarioSelection &selection = ctx.singleton<ScenarioSelection>();
+    WorldRNG &rng = ctx.data().rng;
+
+    int32_t idx = selection.requested;
+    if (idx < 0 || idx >= bank.numScenarios) {
+        switch (bank.sampling) {
+            case ScenarioSampling::Weighted: {
+                const float *cumulative = bank.cumulativeWeights;
+                float r = std::uniform_real_distribution<float>(
+                    0.0f, cumulative[bank.numScenarios - 1])(rng);
+                idx = (int32_t)(std::upper_bound(cumulative,
+                    cumulative + bank.numScenarios, r) - cumulative);
+                idx = std::min(idx, bank.numScenarios - 1);
+                break;
+            }
+            case ScenarioSampling::Curriculum: {
+                // The shared count depends on the order worlds reset in, so
+                // deterministic mode estimates it from this world's resets
+                uint32_t episode = ctx.data().deterministic ?
+                    ctx.data().worldEpisodes * ctx.data().numWorlds :
+                    ctx.data().episodeMgr->curEpisode.load_relaxed();
+                int32_t unlocked = (int32_t)std::min<uint32_t>(bank.numScenarios,
+                    1 + episode / bank.curriculumEpisodesPerStage);
+                idx = std::uniform_int_distribution<int32_t>(0, unlocked - 1)(rng);
+                break;
+            }
+            default: {
+                idx = std::uniform_int_distribution<int32_t>(
+                    0, bank.numScenarios - 1)(rng);
+                break;
+            }
+        }
+    }
+
+    selection.active = idx;
+    return idx;
+}
+
+// Places the ball, players and scorecard for a new episode. A scenario bank
+// takes priority, then the randomization spec, and without either every
+// world starts from the same CourtState.
+static void initializeWorldState(Engine &ctx)
+{
+    const CourtState *court = ctx.data().court;
+    const CourtRandomization *randomization = ctx.data().randomization;
+    const ScenarioBank *scenario_bank = ctx.data().scenarioBank;
+    WorldRNG &rng = ctx.data().rng;
+    auto players = ctx.singleton<AgentList>().e;
+
+    const Scenario *scenario = nullptr;
+    if (scenario_bank != nullptr) {
+        scenario = &scenario_bank->scenarios[pickScenario(ctx, *scenario_bank)];
+    }
+
+    for (int i = 0; i < ACTIVE_PLAYERS; i++){
+        Entity agent = players[i];
+        const Player &src = scenario != nullptr ?
+            scenario->players[i] : court->players[i];
+        CourtPos pos {
+            src.x, src.y, 
+            src.th, src.v, 
+            src.om, src.facing,
+        };
+        StaticPlayerAttributes attributes {
+            DEFAULT_THREE_POINT_PCT, DEFAULT_FIELD_GOAL_PCT, DEFAULT_RUNNING_SPEED_MPH,
+        };
+
+        if (scenario == nullptr && randomization != nullptr) {
+            const PlayerRandomization &spec = randomization->players[i];
+            pos.x = sampleRange(rng, spec.x);
+            pos.y = sampleRange(rng, spec.y);
+            pos.th = sampleRange(rng, spec.th);
+            pos.v = sampleRange(rng, spec.v);
+            pos.facing = sampleRange(rng, spec.facing);
+
+            const AttributeRandomization &attr_spec = randomization->attributes;
+            attributes.shootingPercentage3Points =
+                sampleRange(rng, attr_spec.shootingPercentage3Points);
+            attributes.shootingPercentageFieldGoal =
+                sampleRange(rng, attr_spec.shootingPercentageFieldGoal);
+            attributes.runningSpeedMph =
+                sampleRange(rng, attr_spec.runningSpeedMph);
+        }
+
+        ctx.get<Action>(agent) = Action {
+            0.0, 0.0, 0.0, 0.0, 0.0
+        };
+        ctx.get<CourtPos>(agent) = pos;
+        ctx.get<PlayerStatus>(agent) = {false, false, 0};
+        ctx.get<PlayerDecision>(agent) = PlayerDecision::MOVE;
+        ctx.get<FoulID>(agent) = FoulID::NO_CALL;
+        ctx.get<StaticPlayerAttributes>(agent) = attributes;
+        // Commands from the previous episode refer to positions that no
+        // longer exist
+        ctx.get<MacroCommand>(agent) = MacroCommand {
+            MacroType::NONE, -1, MacroStatus::RUNNING,
+        };
+        ctx.get<MacroParams>(agent) = MacroParams {};
+    }
+
+    int32_t holder = PLAYER_STARTING_WITH_BALL;
+    if (scenario != nullptr) {
+        holder = scenario->whoHolds;
+    } else if (randomization != nullptr) {
+        // Running sums, see CourtRandomization
+        const float *cumulative = randomization->ballHolderWeights;
+        float r = std::uniform_real_distribution<float>(
+            0.0f, cumulative[ACTIVE_PLAYERS])(rng);
+        holder = (int32_t)(std::upper_bound(cumulative,
+            cumulative + ACTIVE_PLAYERS + 1, r) - cumulative);
+        holder = std::min(holder, (int32_t)ACTIVE_PLAYERS);
+        if (holder == ACTIVE_PLAYERS) {
+            holder = -1;
+        }
+    }
+
+    BallState &ball_state = ctx.singleton<BallState>();
+    BallStatus &ball_status = ctx.singleton<BallStatus>();
+    ball_state = BallState {CENTER_X, CENTER_Y, CENTER_Z,};
+    if (holder != -1) {
+        const CourtPos &holder_pos = ctx.get<CourtPos>(players[holder]);
+        ball_state = BallState {holder_pos.x, holder_pos.y, holder_pos.th, holder_pos.v};
+        ball_status = BallStatus {holder, NOT_PREVIOUSLY_SHOT, -1, BallStatesPossibilities::BALL_IS_HELD};
+        ctx.get<PlayerStatus>(players[holder]).hasBall = true;
+    } else {
+        ball_status = BallStatus {holder, NOT_PREVIOUSLY_SHOT, -1, BallStatesPossibilities::BALL_IN_LOOSE};
+    }
+
+    if (scenario != nullptr) {
+        ball_state = BallState {
+            scenario->ballX, scenario->ballY, scenario->ballTh, scenario->ballV,
+        };
+        ball_status.whoShot = scenario->whoShot;
+    }
+
+    ctx.singleton<Scorecard>() = Scorecard {0, 0, 1, 0};
+}
+
+// Worlds flagged through the exported reset tensor start a new episode at
+// the end of the step, so the trainer reads the fresh state right away
+inline void resetSystem(Engine &ctx, WorldReset &reset)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    if (reset.reset == 0) {
+        return;
+    }
+
+    reset.reset = 0;
+    ctx.data().episodeMgr->curEpisode.fetch_add_relaxed(1);
+    ctx.data().worldEpisodes += 1;
+    initializeWorldState(ctx);
+}
+
+static inline uint64_t hashWord(uint64_t hash, uint32_t word)
+{
+    hash ^= word;
+    return hash * 0x100000001b3ull;
+}
+
+static inline uint64_t hashFloat(uint64_t hash, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return hashWord(hash, bits);
+}
+
+// Field by field so struct padding never leaks into the hash
+inline void hashWorldState(Engine &ctx, StateHash &state_hash)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    const AgentList &agents = ctx.singleton<AgentList>();
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        Entity p = agents.e[i];
+        const CourtPos &pos = ctx.get<CourtPos>(p);
+        hash = hashFloat(hash, pos.x);
+        hash = hashFloat(hash, pos.y);
+        hash = hashFloat(hash, pos.th);
+        hash = hashFloat(hash, pos.v);
+        hash = hashFloat(hash, pos.om);
+        hash = hashFloat(hash, pos.facing);
+
+        const PlayerStatus &status = ctx.get<PlayerStatus>(p);
+        hash = hashWord(hash, (uint32_t)status.hasBall);
+        hash = hashWord(hash, (uint32_t)status.justShot);
+        hash = hashWord(hash, (uint32_t)status.pointsOnMake);
+        hash = hashWord(hash, (uint32_t)ctx.get<FoulID>(p));
+
+        const StaticPlayerAttributes &attrs = ctx.get<StaticPlayerAttributes>(p);
+        hash = hashFloat(hash, attrs.shootingPercentage3Points);
+        hash = hashFloat(hash, attrs.shootingPercentageFieldGoal);
+        hash = hashFloat(hash, attrs.runningSpeedMph);
+    }
+
+    const BallState &ball_state = ctx.singleton<BallState>();
+    hash = hashFloat(hash, ball_state.x);
+    hash = hashFloat(hash, ball_state.y);
+    hash = hashFloat(hash, ball_state.th);
+    hash = hashFloat(hash, ball_state.v);
+
+    const BallStatus &ball_status = ctx.singleton<BallStatus>();
+    hash = hashWord(hash, (uint32_t)ball_status.heldBy);
+    hash = hashWord(hash, (uint32_t)ball_status.whoShot);
+    hash = hashWord(hash, (uint32_t)ball_status.whoPassed);
+    hash = hashWord(hash, (uint32_t)ball_status.ballState);
+
+    const Scorecard &score = ctx.singleton<Scorecard>();
+    hash = hashWord(hash, (uint32_t)score.score1);
+    hash = hashWord(hash, (uint32_t)score.score2);
+    hash = hashWord(hash, (uint32_t)score.quarter);
+    hash = hashWord(hash, (uint32_t)score.ticksElapsed);
+
+    const GameEventLog &log = ctx.singleton<GameEventLog>();
+    hash = hashWord(hash, log.numEmitted);
+    if (log.numEmitted > 0) {
+        const GameEvent &last = log.events[(log.numEmitted - 1) % EVENT_LOG_CAPACITY];
+        hash = hashWord(hash, (uint32_t)last.type);
+        hash = hashWord(hash, (uint32_t)last.playerId);
+        hash = hashWord(hash, (uint32_t)last.data);
+    }
+
+    state_hash.hash = hash;
+}
+
+// Fills every cell of one channel whose center lies within radius of (x, y)
+static inline void stampDisk(uint8_t *channel, uint32_t width, uint32_t height,
+                             float x, float y, float radius, uint8_t value)
+{
+    float ft_per_col = COURT_WIDTH / (float)width;
+    float ft_per_row = COURT_HEIGHT / (float)height;
+
+    int32_t col_min = std::max(0, (int32_t)((x - radius - MIN_X) / ft_per_col));
+    int32_t col_max = std::min((int32_t)width - 1,
+        (int32_t)((x + radius - MIN_X) / ft_per_col));
+    int32_t row_min = std::max(0, (int32_t)((y - radius - MIN_Y) / ft_per_row));
+    int32_t row_max = std::min((int32_t)height - 1,
+        (int32_t)((y + radius - MIN_Y) / ft_per_row));
+
+    float radius_sq = radius * radius;
+    for (int32_t row = row_min; row <= row_max; row++) {
+        float cy = MIN_Y + ((float)row + 0.5f) * ft_per_row - y;
+        for (int32_t col = col_min; col <= col_max; col++) {
+            float cx = MIN_X + ((float)col + 0.5f) * ft_per_col - x;
+            // Always mark the containing cell so small disks never vanish
+            bool contains = (int32_t)((x - MIN_X) / ft_per_col) == col &&
+                (int32_t)((y - MIN_Y) / ft_per_row) == row;
+            if (contains || cx * cx + cy * cy <= radius_sq) {
+                channel[row * width + col] = value;
+            }
+        }
+    }
+}
+
+static inline uint8_t encodeRasterVelocity(float v)
+{
+    float scaled = 128.0f + 127.0f * v / RASTER_MAX_SPEED;
+    return (uint8_t)std::min(255.0f, std::max(0.0f, scaled));
+}
+
+// Rows run from MIN_Y to MAX_Y and columns from MIN_X to MAX_X
+inline void rasterizeWorld(Engine &ctx,
+                           BallState &ball_state)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    uint8_t *raster = ctx.data().raster;
+    uint32_t width = ctx.data().rasterWidth;
+    uint32_t height = ctx.data().rasterHeight;
+    uint32_t channel_size = width * height;
+
+    auto channel = [&](RasterChannel c) {
+        return raster + (uint32_t)c * channel_size;
+    };
+
+    memset(raster, 0, (size_t)RASTER_NUM_CHANNELS * channel_size);
+    memset(channel(RasterChannel::VelocityX), 128, channel_size);
+    memset(channel(RasterChannel::VelocityY), 128, channel_size);
+
+    stampDisk(channel(RasterChannel::Hoops), width, height,
+              LEFT_HOOP_X, LEFT_HOOP_Y, RASTER_HOOP_RADIUS, 255);
+    stampDisk(channel(RasterChannel::Hoops), width, height,
+              RIGHT_HOOP_X, RIGHT_HOOP_Y, RASTER_HOOP_RADIUS, 255);
+
+    auto players = ctx.singleton<AgentList>().e;
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        const CourtPos &pos = ctx.get<CourtPos>(players[i]);
+        RasterChannel team = i < FIRST_TEAM2_PLAYER ?
+            RasterChannel::Team1 : RasterChannel::Team2;
+
+        stampDisk(channel(team), width, height,
+                  pos.x, pos.y, RASTER_PLAYER_RADIUS, 255);
+        stampDisk(channel(RasterChannel::VelocityX), width, height,
+                  pos.x, pos.y, RASTER_PLAYER_RADIUS,
+                  encodeRasterVelocity(pos.v * cosf(pos.th)));
+        stampDisk(channel(RasterChannel::VelocityY), width, height,
+                  pos.x, pos.y, RASTER_PLAYER_RADIUS,
+                  encodeRasterVelocity(pos.v * sinf(pos.th)));
+    }
+
+    stampDisk(channel(RasterChannel::Ball), width, height,
+              ball_state.x, ball_state.y, RASTER_BALL_RADIUS, 255);
+}
+
+// Converts one value for the QuantizedState export, fp16 keeps the raw
+// value while int16 needs angles wrapped to stay in range
+static inline uint16_t quantize(ObservationPrecision precision,
+                                float value, float scale, bool angle)
+{
+    if (precision == ObservationPrecision::Float16) {
+        return floatToHalf(value);
+    }
+    return floatToFixed16(angle ? wrapAngle(value) : value, scale);
+}
+
+inline void quantizeState(Engine &ctx, QuantizedState &state)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    ObservationPrecision precision = ctx.data().observationPrecision;
+    auto players = ctx.singleton<AgentList>().e;
+
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        const CourtPos &pos = ctx.get<CourtPos>(players[i]);
+        uint16_t *out = state.players[i];
+        out[0] = quantize(precision, pos.x, QUANT_POSITION_SCALE, false);
+        out[1] = quantize(precision, pos.y, QUANT_POSITION_SCALE, false);
+        out[2] = quantize(precision, pos.th, QUANT_ANGLE_SCALE, true);
+        out[3] = quantize(precision, pos.v, QUANT_SPEED_SCALE, false);
+        out[4] = quantize(precision, pos.om, QUANT_ANGULAR_SCALE, false);
+        out[5] = quantize(precision, pos.facing, QUANT_ANGLE_SCALE, true);
+
+        const Action &action = ctx.get<Action>(players[i]);
+        out = state.actions[i];
+        out[0] = quantize(precision, action.vdes, QUANT_SPEED_SCALE, false);
+        out[1] = quantize(precision, action.thdes, QUANT_ANGLE_SCALE, true);
+        out[2] = quantize(precision, action.omdes, QUANT_ANGULAR_SCALE, false);
+        out[3] = quantize(precision, action.pass_th, QUANT_ANGLE_SCALE, true);
+        out[4] = quantize(precision, action.pass_v, QUANT_SPEED_SCALE, false);
+    }
+
+    const BallState &ball = ctx.singleton<BallState>();
+    state.ball[0] = quantize(precision, ball.x, QUANT_POSITION_SCALE, false);
+    state.ball[1] = quantize(precision, ball.y, QUANT_POSITION_SCALE, false);
+    state.ball[2] = quantize(precision, ball.th, QUANT_ANGLE_SCALE, true);
+    state.ball[3] = quantize(precision, ball.v, QUANT_SPEED_SCALE, false);
+}
+
+// Same row as Manager::Impl::writeObservations
+static void writeObservationFrame(Engine &ctx, float *frame)
+{
+    auto players = ctx.singleton<AgentList>().e;
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        memcpy(frame + i * 6, &ctx.get<CourtPos>(players[i]),
+               sizeof(CourtPos));
+    }
+
+    float *ball = frame + ACTIVE_PLAYERS * 6;
+    memcpy(ball, &ctx.singleton<BallState>(), sizeof(BallState));
+
+    const BallStatus &status = ctx.singleton<BallStatus>();
+    ball[4] = (float)status.heldBy;
+    ball[5] = (float)status.whoShot;
+    ball[6] = (float)status.whoPassed;
+    ball[7] = (float)status.ballState;
+
+    const Scorecard &score = ctx.singleton<Scorecard>();
+    ball[8] = (float)score.score1;
+    ball[9] = (float)score.score2;
+    ball[10] = (float)score.quarter;
+    ball[11] = (float)score.ticksElapsed;
+}
+
+// Shifts the frames back by one and writes the current state to frames[0].
+// A world that started a new episode this step gets the fresh state in
+// every frame, so nothing from the old episode leaks into the stack.
+inline void updateObservationHistory(Engine &ctx, ObservationHistory &history)
+{
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
+    if (ctx.data().historyEpisode != ctx.data().worldEpisodes) {
+        ctx.data().historyEpisode = ctx.data().worldEpisodes;
+        writeObservationFrame(ctx, history.frames[0]);
+        for (int i = 1; i < OBS_HISTORY_FRAMES; i++) {
+            memcpy(history.frames[i], history.frames[0],
+                   sizeof(history.frames[0]));
+        }
+        return;
+    }
+
+    memmove(history.frames[1], history.frames[0],
+            sizeof(history.frames[0]) * (OBS_HISTORY_FRAMES - 1));
+    writeObservationFrame(ctx, history.frames[0]);
+}
+
+template <int32_t substep>
+static TaskGraphNodeID addSubstep(TaskGraphBuilder &builder,
+                                  const Sim::Config &cfg,
+                                  TaskGraphNodeID dep)
+{
+    auto movementfunc = builder.addToGraph<ParallelForNode<Engine,
+        movePlayerStep<substep>, Action, CourtPos>>({dep});
+
+    auto geometryfunc = builder.addToGraph<ParallelForNode<Engine,
+        substepPairwiseGeometry<substep>, PairwiseGeometry>>({movementfunc});
+
+    if (cfg.deterministic) {
+        return builder.addToGraph<ParallelForNode<Engine,
+            runPlayersInOrder<checkForBlockCharge<substep>>, AgentList>>(
+                {geometryfunc});
+    }
+    return builder.addToGraph<ParallelForNode<Engine, checkForBlockCharge<substep>,
+        Action, CourtPos, PlayerID, PlayerStatus, PlayerDecision, FoulID>>(
+            {geometryfunc});
+}
+
+template <int32_t... substeps>
+static TaskGraphNodeID addSubsteps(TaskGraphBuilder &builder,
+                                   const Sim::Config &cfg,
+                                   TaskGraphNodeID dep,
+                                   std::integer_sequence<int32_t, substeps...>)
+{
+    ((dep = addSubstep<substeps>(builder, cfg, dep)), ...);
+    return dep;
+}
+
 void Sim::setupTasks(TaskGraphManager &taskgraph_mgr,
-                     const Config &)
+                     const Config &cfg)
 {
     TaskGraphBuilder &builder = taskgraph_mgr.init(0);
     
-    auto actionfunc = builder.addToGraph<ParallelForNode<Engine, takePlayerAction,
-        Action, CourtPos, PlayerID, PlayerStatus, PlayerDecision, FoulID>>({});
-
-    auto movementfunc = builder.addToGraph<ParallelForNode<Engine, movePlayerStep,
-        Action, CourtPos>>({actionfunc});
+    // Movement and postprocess only write the player's own rows, the
+    // systems below also touch other players and the ball
+    auto addPlayerActions = [&](TaskGraphNodeID dep) {
+        if (cfg.deterministic) {
+            return builder.addToGraph<ParallelForNode<Engine,
+                runPlayersInOrder<takePlayerAction>, AgentList>>({dep});
+        }
+        return builder.addToGraph<ParallelForNode<Engine, takePlayerAction,
+            Action, CourtPos, PlayerID, PlayerStatus, PlayerDecision, FoulID>>({dep});
+    };
 
-    auto blockchargecheck = builder.addToGraph<ParallelForNode<Engine, checkForBlockCharge,
-        Action, CourtPos, PlayerID, PlayerStatus, PlayerDecision, FoulID>>({movementfunc});
+    auto macrofunc = builder.addToGraph<ParallelForNode<Engine, runMacroController,
+        Action, CourtPos, PlayerID, PlayerDecision, MacroCommand, MacroParams>>({});
 
-    for (int i = 1; i < COLLISION_CHECK_STEPS; i++){
+    auto actionfunc = addPlayerActions(macrofunc);
 
-        movementfunc = builder.addToGraph<ParallelForNode<Engine, movePlayerStep,
-            Action, CourtPos>>({blockchargecheck});
+    auto substepplan = builder.addToGraph<ParallelForNode<Engine, planSubsteps,
+        SubstepSchedule>>({actionfunc});
 
-        blockchargecheck = builder.addToGraph<ParallelForNode<Engine, checkForBlockCharge,
-            Action, CourtPos, PlayerID, PlayerStatus, PlayerDecision, FoulID>>({movementfunc});
-    }
+    auto blockchargecheck = addSubsteps(builder, cfg, substepplan,
+        std::make_integer_sequence<int32_t, COLLISION_CHECK_STEPS>());
 
     auto ballfunc = builder.addToGraph<ParallelForNode<Engine, balltick,
-        BallState, BallStatus>>({blockchargecheck});
+        BallState>>({blockchargecheck});
 
-    builder.addToGraph<ParallelForNode<Engine, postprocess, PlayerID,
+    auto postfunc = builder.addToGraph<ParallelForNode<Engine, postprocess, PlayerID,
         PlayerStatus>>({ballfunc});
+
+    auto boxscorefunc = builder.addToGraph<ParallelForNode<Engine, accumulateBoxScore,
+        BoxScore>>({postfunc});
+
+    auto resetfunc = builder.addToGraph<ParallelForNode<Engine, resetSystem,
+        WorldReset>>({boxscorefunc});
+
+    // Collision reverts, the ball and resets all move things after the last
+    // substep's pass, so the exported geometry is redone on the final state
+    builder.addToGraph<ParallelForNode<Engine, computePairwiseGeometry,
+        PairwiseGeometry>>({resetfunc});
+
+    builder.addToGraph<ParallelForNode<Engine, updateCourtZone,
+        CourtPos, CourtZone>>({resetfunc});
+
+    if (cfg.enableRaster) {
+        builder.addToGraph<ParallelForNode<Engine, rasterizeWorld,
+            BallState>>({resetfunc});
+    }
+
+    if (cfg.deterministic) {
+        builder.addToGraph<ParallelForNode<Engine, hashWorldState,
+            StateHash>>({resetfunc});
+    }
+
+    if (cfg.observationPrecision != ObservationPrecision::Float32) {
+        builder.addToGraph<ParallelForNode<Engine, quantizeState,
+            QuantizedState>>({resetfunc});
+    }
+
+    if (cfg.observationHistory) {
+        builder.addToGraph<ParallelForNode<Engine, updateObservationHistory,
+            ObservationHistory>>({resetfunc});
+    }
 }
 
 Sim::Sim(Engine &ctx, const Config &cfg, const WorldInit &init)
     : WorldBase(ctx),
       episodeMgr(init.episodeMgr),
       court(init.court),
+      shotModel(init.shotModel),
+      courtZones(init.courtZones),
+      randomization(init.randomization),
+      scenarioBank(init.scenarioBank),
+      raster(init.raster),
+      rasterWidth(cfg.rasterWidth),
+      rasterHeight(cfg.rasterHeight),
       dt(D_T),
-      maxEpisodeLength(cfg.maxEpisodeLength)
+      maxEpisodeLength(cfg.maxEpisodeLength),
+      deterministic(cfg.deterministic),
+      adaptiveSubsteps(cfg.adaptiveSubsteps),
+      observationPrecision(cfg.observationPrecision),
+      numWorlds(cfg.numWorlds),
+      worldEpisodes(0),
+      historyEpisode(0)
 {
-    ctx.singleton<BallReference>().theBall = ctx.makeEntity<BallArchetype>();
-    ctx.get<BallState>(ctx.singleton<BallReference>().theBall) = BallState {CENTER_X, CENTER_Y, CENTER_Z,};
-    if (PLAYER_STARTING_WITH_BALL != -1) {
-        ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall) = BallStatus {PLAYER_STARTING_WITH_BALL, NOT_PREVIOUSLY_SHOT, -1, BallStatesPossibilities::BALL_IS_HELD};
-    } else {
-        ctx.get<BallStatus>(ctx.singleton<BallReference>().theBall) = BallStatus {PLAYER_STARTING_WITH_BALL, NOT_PREVIOUSLY_SHOT, -1, BallStatesPossibilities::BALL_IN_LOOSE};
-    }
-    ctx.singleton<GameReference>().theGame = ctx.makeEntity<GameState>();
-    ctx.get<Scorecard>(ctx.singleton<GameReference>().theGame) = Scorecard {0, 0, 1, 0};
-
+    std::seed_seq seeds {cfg.seed, (uint32_t)ctx.worldID().idx};
+    rng.seed(seeds);
 
     for (int i = 0; i < ACTIVE_PLAYERS; i++){
         Entity agent = ctx.makeEntity<Agent>();
-        ctx.get<Action>(agent) = Action {
-            CENTER_X, CENTER_Y, CENTER_Z, 0.0, 0.0
-        };
-        ctx.get<CourtPos>(agent) = CourtPos {
-            court->players[i].x, court->players[i].y, 
-            court->players[i].th, court->players[i].v, 
-            court->players[i].om, court->players[i].facing,
-        };
         ctx.get<PlayerID>(agent).id = i;
-        ctx.get<PlayerStatus>(agent) = {false, false, 0};
-        ctx.get<FoulID>(agent) = FoulID::NO_CALL;
-        ctx.get<StaticPlayerAttributes>(agent) = {0.0, 0.0, 0.0};
         ctx.singleton<AgentList>().e[i] = agent;
     }
-    
+
+    ctx.singleton<WorldReset>().reset = 0;
+    ctx.singleton<WorldActive>().active = 1;
+    ctx.singleton<TeamPolicies>() = TeamPolicies {{0, 0}};
+    ctx.singleton<ScenarioSelection>() = ScenarioSelection {-1, -1};
+    ctx.singleton<GameEventLog>().numEmitted = 0;
+    ctx.singleton<BoxScore>() = BoxScore {};
+    ctx.singleton<SubstepSchedule>().numSubsteps = COLLISION_CHECK_STEPS;
+    ctx.singleton<SubstepStats>() = SubstepStats {};
+    boxScoreCursor = 0;
+    ctx.singleton<StateHash>().hash = 0;
+    ctx.singleton<PairwiseGeometry>() = PairwiseGeometry {};
+    if (observationPrecision != ObservationPrecision::Float32) {
+        ctx.singleton<QuantizedState>() = QuantizedState {};
+    }
+    if (cfg.observationHistory) {
+        ctx.singleton<ObservationHistory>() = ObservationHistory {};
+    }
+
+    // The manager bulk fills the exported state of every world afterwards,
+    // only what it can't reach is set here, including the observation
+    // history, pairwise geometry and court zones. Raster, hash and
+    // quantized state catch up at the end of the first step.
+    if (cfg.lazyInit) {
+        for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+            Entity agent = ctx.singleton<AgentList>().e[i];
+            ctx.get<PlayerStatus>(agent) =
+                {i == PLAYER_STARTING_WITH_BALL, false, 0};
+        }
+        return;
+    }
+
+    initializeWorldState(ctx);
+    computePairwiseGeometry(ctx, ctx.singleton<PairwiseGeometry>());
+    for (int i = 0; i < ACTIVE_PLAYERS; i++) {
+        Entity agent = ctx.singleton<AgentList>().e[i];
+        updateCourtZone(ctx, ctx.get<CourtPos>(agent),
+                        ctx.get<CourtZone>(agent));
+    }
+
+    if (raster != nullptr) {
+        rasterizeWorld(ctx, ctx.singleton<BallState>());
+    }
+
+    if (deterministic) {
+        hashWorldState(ctx, ctx.singleton<StateHash>());
+    }
+
+    if (observationPrecision != ObservationPrecision::Float32) {
+        quantizeState(ctx, ctx.singleton<QuantizedState>());
+    }
+
+    if (cfg.observationHistory) {
+        // Mismatched episode, so every frame starts as the initial state
+        historyEpisode = ~0u;
+        updateObservationHistory(ctx, ctx.singleton<ObservationHistory>());
+    }
 }
 
 MADRONA_BUILD_MWGPU_ENTRY(Engine, Sim, Sim::Config, WorldInit);
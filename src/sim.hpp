@@ -7,6 +7,10 @@
 #include "consts.hpp"
 #include "types.hpp"
 #include "init.hpp"
+#include "shot_model.hpp"
+#include "court_zones.hpp"
+#include "rng.hpp"
+#include "scenario_bank.hpp"
 
 namespace madsimple {
 
@@ -16,6 +20,25 @@ struct Sim : public madrona::WorldBase {
     struct Config {
         uint32_t maxEpisodeLength;
         bool enableViewer;
+        uint32_t seed;
+        bool enableRaster;
+        uint32_t rasterWidth;
+        uint32_t rasterHeight;
+        // Runs the player systems serially in player ID order and hashes
+        // the world state every tick, see Manager::Config::deterministic
+        bool deterministic;
+        uint32_t numWorlds;
+        // Pick the substep count per world each tick instead of always
+        // running COLLISION_CHECK_STEPS
+        bool adaptiveSubsteps;
+        // Fill the QuantizedState export after every step
+        ObservationPrecision observationPrecision;
+        // Only create entities, Manager::Impl::bulkInitialize writes the
+        // initial state
+        bool lazyInit;
+        // Keep the last OBS_HISTORY_FRAMES observations in
+        // ObservationHistory
+        bool observationHistory;
     };
 
     static void registerTypes(madrona::ECSRegistry &registry,
@@ -29,7 +52,24 @@ struct Sim : public madrona::WorldBase {
     float dt;
     EpisodeManager *episodeMgr;
     const CourtState *court; // Add court to constructor
+    const ShotModel *shotModel;
+    const CourtZoneGrid *courtZones;
+    const CourtRandomization *randomization; // nullptr: every reset copies court
+    const ScenarioBank *scenarioBank; // nullptr: no compiled scenarios loaded
+    uint8_t *raster; // this world's [C, H, W] image, nullptr when disabled
+    uint32_t rasterWidth;
+    uint32_t rasterHeight;
+    uint32_t boxScoreCursor; // events already folded into the BoxScore
     uint32_t maxEpisodeLength;
+    bool deterministic;
+    bool adaptiveSubsteps;
+    ObservationPrecision observationPrecision;
+    uint32_t numWorlds;
+    uint32_t worldEpisodes; // resets of this world only
+    uint32_t historyEpisode; // worldEpisodes the history frames belong to
+
+    // Per world generator, seeded from Config::seed and the world index
+    WorldRNG rng;
 };
 
 class Engine : public ::madrona::CustomContext<Engine, Sim> {
@@ -10,7 +10,6 @@ using madrona::Entity;
 enum class ExportID : uint32_t {
     Action,
     CourtPos, // Added a player position archetype for sim
-    NumExports,
     BallLoc,
     WhoHolds,
     PassingData,
@@ -18,7 +17,31 @@ enum class ExportID : uint32_t {
     StaticPlayerAttributes,
     Choice,
     CalledFoul, 
-    Reset
+    Reset,
+    ScenarioSelection,
+    Events,
+    BoxScore,
+    StateHash,
+    SubstepStats,
+    WorldActive,
+    MacroCommand,
+    MacroParams,
+    QuantizedState,
+    PolicyID,
+    ObservationHistory,
+    PairwiseGeometry,
+    CourtZone,
+    NumExports,
+};
+
+// Channel order of the raster observation, [numWorlds, C, H, W] uint8
+enum class RasterChannel : int32_t {
+    Team1 = 0,
+    Team2 = 1,
+    Ball = 2,
+    Hoops = 3,
+    VelocityX = 4,
+    VelocityY = 5,
 };
 
 enum class PlayerDecision : int32_t {
@@ -35,10 +58,109 @@ enum class FoulID : int32_t {
     PUSH = 3,
 };
 
+enum class GameEventType : int32_t {
+    SHOT = 0,  // data: 2 or 3, the value of the attempt
+    MAKE = 1,  // data: points scored
+    MISS = 2,
+    PASS = 3,
+    CATCH = 4, // data: passer, or -1 for a loose ball or rebound
+    STEAL = 5, // data: passer whose pass was picked off
+    FOUL = 6,  // data: FoulID
+};
+
+struct GameEvent {
+    GameEventType type;
+    int32_t tick;
+    int32_t playerId;
+    int32_t data;
+};
+
+// Ring buffer, event n lives in events[n % EVENT_LOG_CAPACITY]. numEmitted
+// only ever grows so readers can keep a cursor across steps and resets.
+struct GameEventLog {
+    GameEvent events[EVENT_LOG_CAPACITY];
+    uint32_t numEmitted;
+};
+
+// Running per player stats built from the event log, all counts
+struct PlayerBoxScore {
+    int32_t points;
+    int32_t fieldGoalsAttempted;
+    int32_t fieldGoalsMade;
+    int32_t threesAttempted;
+    int32_t threesMade;
+    int32_t passes;
+    // Only steals turn the ball over in the simulator, there is no shot
+    // clock or out of bounds, so this counts the player's passes that the
+    // other team picked off
+    int32_t passesStolen;
+    int32_t steals;
+    int32_t fouls;
+};
+
+constexpr int NUM_BOX_SCORE_STATS = sizeof(PlayerBoxScore) / sizeof(int32_t);
+
+struct BoxScore {
+    PlayerBoxScore players[ACTIVE_PLAYERS];
+};
+
+// FNV-1a over every field that carries over between ticks, only kept up to
+// date in deterministic mode so record/replay runs can be compared per tick
+struct StateHash {
+    uint64_t hash;
+};
+
+// Movement/collision substeps this world runs in the current tick
+struct SubstepSchedule {
+    int32_t numSubsteps;
+};
+
+// Running totals since the world was created, substeps / ticks is the
+// average substep count actually executed
+struct SubstepStats {
+    uint32_t ticks;
+    uint32_t substeps;
+};
+
+// Reduced precision copy of every player's CourtPos, the BallState and
+// every player's Action, as fp16 bits or int16 fixed point depending on
+// ObservationPrecision. Exported flat, QUANT_STATE_WIDTH values per world.
+struct QuantizedState {
+    uint16_t players[ACTIVE_PLAYERS][6];
+    uint16_t ball[4];
+    uint16_t actions[ACTIVE_PLAYERS][5];
+};
+
+// Which policy drives each team of this world, set by the trainer and
+// used by Manager::gatherPolicyBatches. Negative ids are left out.
+struct TeamPolicies {
+    int32_t policyId[2];
+};
+
+// Player-player and player-ball geometry of the current positions. The
+// player distances are refreshed after every movement substep for the rule
+// checks, closingSpeed and ballDistance only at the end of the step since
+// nothing reads them within one. closingSpeed[i][j] is how fast i and j
+// approach each other (negative when separating), both matrices are
+// symmetric.
+struct PairwiseGeometry {
+    float distance[ACTIVE_PLAYERS][ACTIVE_PLAYERS];
+    float closingSpeed[ACTIVE_PLAYERS][ACTIVE_PLAYERS];
+    float ballDistance[ACTIVE_PLAYERS];
+};
+
+// The last OBS_HISTORY_FRAMES observation rows (same layout as the rollout
+// collector's), frames[0] is the state after the latest step
+struct ObservationHistory {
+    float frames[OBS_HISTORY_FRAMES][ROLLOUT_OBS_DIM];
+};
+
+// Packed into one byte, pointsOnMake only ever holds 0, 2 or 3: the shot's
+// value from release, then what it scores if it goes in
 struct PlayerStatus {
-    bool hasBall;
-    bool justShot; // TODO: do we need?
-    int32_t pointsOnMake;
+    uint8_t hasBall : 1;
+    uint8_t justShot : 1; // TODO: do we need?
+    uint8_t pointsOnMake : 2;
 };
 
 struct Action {
@@ -64,6 +186,18 @@ struct WorldReset {
     int32_t reset;
 };
 
+// 0 skips the world in every task until it is set back to 1
+struct WorldActive {
+    int32_t active;
+};
+
+// requested: scenario to load on the next reset, -1 samples from the bank
+// active: scenario the current episode started from, -1 without a bank
+struct ScenarioSelection {
+    int32_t requested;
+    int32_t active;
+};
+
 struct StaticPlayerAttributes {
     float shootingPercentage3Points;
     float shootingPercentageFieldGoal;
@@ -77,15 +211,6 @@ struct Scorecard {
     int32_t ticksElapsed;
 };
 
-struct BallReference {
-   Entity theBall;
-};
-
-
-struct GameReference {
-    Entity theGame;
-};
-
 struct PlayerID {
     int32_t id;
 };
@@ -113,6 +238,42 @@ struct BallStatus {
     BallStatesPossibilities ballState;
 };
 
+// Optional high level command per player, turned into Action and
+// PlayerDecision every tick by runMacroController until it completes
+enum class MacroType : int32_t {
+    NONE = 0, // Action and PlayerDecision are used as written
+    MOVE_TO = 1, // run to (x, y) at speed, done on arrival
+    PASS_TO = 2, // lead pass to player target at speed (0: default pass speed)
+    SHOOT = 3, // shoot this tick, fails without the ball
+    SHOOT_WHEN_OPEN = 4, // go to (x, y) and shoot once no defender is within openDistance
+};
+
+enum class MacroStatus : int32_t {
+    RUNNING = 0,
+    DONE = 1,
+    FAILED = 2,
+};
+
+struct MacroCommand {
+    MacroType type;
+    int32_t target;
+    MacroStatus status; // written by the controller
+};
+
+struct MacroParams {
+    float x;
+    float y;
+    float speed;
+    float openDistance;
+};
+
+// Where the player stands after the latest step, from the court zone grid:
+// COURT_ZONE_* bits and the index of the closest INBOUND_POINTS entry
+struct CourtZone {
+    uint32_t zone;
+    int32_t nearestInbound;
+};
+
 struct AgentList {
     madrona::Entity e[ACTIVE_PLAYERS];
 };
@@ -124,15 +285,9 @@ struct Agent : public madrona::Archetype<
     PlayerStatus,
     PlayerDecision,
     FoulID,
-    StaticPlayerAttributes
-> {};
-
-struct BallArchetype : public madrona::Archetype<
-    BallState,
-    BallStatus
-> {};
-
-struct GameState : public madrona::Archetype<
-    Scorecard
+    StaticPlayerAttributes,
+    MacroCommand,
+    MacroParams,
+    CourtZone
 > {};
 }
\ No newline at end of file